@@ -0,0 +1,58 @@
+'use strict'
+
+// Messages/s through individual sendFloat() calls vs. one sendBatch() per chunk.
+//   node bench/batch.js [messages=200000] [chunk=256] [--start]
+// Without --start the engine is stopped and both paths call libpd directly from
+// the JS thread; with --start they go through the command queue to the device.
+
+const { PdEngine, PdBatch } = require('..')
+
+const args = process.argv.slice(2)
+const start = args.includes('--start')
+const numbers = args.filter((a) => !a.startsWith('--')).map(Number)
+const total = numbers[0] || 200000
+const chunk = numbers[1] || 256
+
+const engine = new PdEngine({ commandQueueSize: 1 << 16 })
+if (start) engine.start()
+
+function rate(label, fn) {
+    fn(Math.min(total, 10000)) // warm-up
+    const t0 = process.hrtime.bigint()
+    fn(total)
+    const seconds = Number(process.hrtime.bigint() - t0) / 1e9
+    const perSecond = total / seconds
+    console.log(`${label.padEnd(24)} ${(perSecond / 1e6).toFixed(2)} M msg/s`)
+    return perSecond
+}
+
+// Avec le moteur démarré, on laisse le callback vider la file entre deux paquets
+function pace() {
+    if (!start) return
+    while (engine.getStats().commands.pending > (1 << 15)) {
+        Atomics.wait(new Int32Array(new SharedArrayBuffer(4)), 0, 0, 1)
+    }
+}
+
+const single = rate('sendFloat', (n) => {
+    for (let i = 0; i < n; ++i) {
+        engine.sendFloat('bench', i)
+        if ((i & 4095) === 0) pace()
+    }
+})
+
+const batch = new PdBatch(chunk * 16)
+const batched = rate(`sendBatch (chunk ${chunk})`, (n) => {
+    for (let i = 0; i < n; i += chunk) {
+        batch.reset()
+        const end = Math.min(n, i + chunk)
+        for (let j = i; j < end; ++j) batch.float('bench', j)
+        engine.sendBatch(batch.finish())
+        pace()
+    }
+})
+
+console.log(`speedup x${(batched / single).toFixed(1)}`)
+const stats = engine.getStats().commands
+if (stats.overflows) console.log(`command queue overflows: ${stats.overflows}`)
+if (start) engine.stop()
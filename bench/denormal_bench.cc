@@ -0,0 +1,69 @@
+// Per-tick cost of a decaying-filter patch with and without flush-to-zero.
+//
+//   denormal_bench [patch.pd] [ticks]
+//
+// The patch is reopened before each run so both runs start from the same state.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "denormals.h"
+
+extern "C"
+{
+#include "z_libpd.h"
+}
+
+static double RunTicks(const std::string &dir, const std::string &name, int ticks, bool flush)
+{
+    void *patch = libpd_openfile(name.c_str(), dir.c_str());
+    if (!patch)
+    {
+        std::fprintf(stderr, "cannot open %s%s\n", dir.c_str(), name.c_str());
+        std::exit(1);
+    }
+    std::vector<float> out(64 * 2);
+    ScopedDenormalGuard guard(flush);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ticks; ++i)
+        libpd_process_float(1, nullptr, out.data());
+    auto t1 = std::chrono::steady_clock::now();
+    libpd_closefile(patch);
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / ticks;
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "bench/patches/decay.pd";
+    int ticks = argc > 2 ? std::atoi(argv[2]) : 200000; // ~4.5 min de signal à 48 kHz
+
+    std::string dir, name;
+    auto pos = path.find_last_of("/\\");
+    if (pos == std::string::npos)
+    {
+        dir = ".";
+        name = path;
+    }
+    else
+    {
+        dir = path.substr(0, pos);
+        name = path.substr(pos + 1);
+    }
+
+    libpd_init();
+    libpd_init_audio(0, 2, 48000);
+    libpd_start_message(1);
+    libpd_add_float(1.0f);
+    libpd_finish_message("pd", "dsp");
+
+    const double off = RunTicks(dir, name, ticks, false);
+    const double on = RunTicks(dir, name, ticks, true);
+    std::printf("%s, %d ticks\n", path.c_str(), ticks);
+    std::printf("  FTZ/DAZ off: %8.1f ns/tick\n", off);
+    std::printf("  FTZ/DAZ on:  %8.1f ns/tick\n", on);
+    std::printf("  speedup:     %8.2fx\n", on > 0.0 ? off / on : 0.0);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+// Taille d'une ligne de cache : alignement des buffers et compteurs partagés avec le thread audio
+constexpr std::size_t kCacheLineSize = 64;
+
+// Owning, cache-line aligned, zero-initialised array of trivially copyable values.
+// Memory is only (re)allocated by Allocate()/Release(), which must never be called
+// from the audio thread; the callback just reuses whatever was sized in start().
+template <typename T>
+class AlignedBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "AlignedBuffer holds plain audio data only");
+
+public:
+    AlignedBuffer() = default;
+    ~AlignedBuffer() { Release(); }
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    void Allocate(std::size_t count)
+    {
+        Release();
+        if (count == 0)
+            return;
+        data_ = static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(kCacheLineSize)));
+        size_ = count;
+        Clear();
+    }
+
+    void Release()
+    {
+        if (data_)
+        {
+            ::operator delete(data_, std::align_val_t(kCacheLineSize));
+            data_ = nullptr;
+            size_ = 0;
+        }
+    }
+
+    void Clear()
+    {
+        if (data_)
+            std::memset(data_, 0, size_ * sizeof(T));
+    }
+
+    T *Data() { return data_; }
+    const T *Data() const { return data_; }
+    std::size_t Size() const { return size_; }
+
+private:
+    T *data_ = nullptr;
+    std::size_t size_ = 0;
+};
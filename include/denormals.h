@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PD_DENORMALS_X86 1
+#include <xmmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PD_DENORMALS_ARM64 1
+#elif defined(__arm__) && defined(__ARM_FP)
+#define PD_DENORMALS_ARM32 1
+#endif
+
+// Enables flush-to-zero / denormals-are-zero on the calling thread for the
+// lifetime of the object and restores the previous FPU state when it goes out of
+// scope. Decaying IIR filters and feedback loops otherwise drift into subnormal
+// numbers, which are 10-100x slower on most CPUs. x86 sets MXCSR FTZ (bit 15) and
+// DAZ (bit 6); ARM sets FPCR/FPSCR FZ (bit 24). A disabled guard does nothing.
+class ScopedDenormalGuard
+{
+public:
+    explicit ScopedDenormalGuard(bool enable = true) : enabled_(enable)
+    {
+        if (!enabled_)
+            return;
+        saved_ = Read();
+        Write(saved_ | kFlushBits);
+    }
+
+    ~ScopedDenormalGuard()
+    {
+        if (enabled_)
+            Write(saved_);
+    }
+
+    ScopedDenormalGuard(const ScopedDenormalGuard &) = delete;
+    ScopedDenormalGuard &operator=(const ScopedDenormalGuard &) = delete;
+
+private:
+#if defined(PD_DENORMALS_X86)
+    static constexpr uintptr_t kFlushBits = 0x8040; // FTZ | DAZ
+    static uintptr_t Read() { return _mm_getcsr(); }
+    static void Write(uintptr_t v) { _mm_setcsr((unsigned int)v); }
+#elif defined(PD_DENORMALS_ARM64) && !defined(_MSC_VER)
+    static constexpr uintptr_t kFlushBits = 1u << 24; // FZ
+    static uintptr_t Read()
+    {
+        uint64_t v;
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(v));
+        return (uintptr_t)v;
+    }
+    static void Write(uintptr_t v) { __asm__ __volatile__("msr fpcr, %0" : : "r"((uint64_t)v)); }
+#elif defined(PD_DENORMALS_ARM32)
+    static constexpr uintptr_t kFlushBits = 1u << 24; // FZ
+    static uintptr_t Read()
+    {
+        uint32_t v;
+        __asm__ __volatile__("vmrs %0, fpscr" : "=r"(v));
+        return v;
+    }
+    static void Write(uintptr_t v) { __asm__ __volatile__("vmsr fpscr, %0" : : "r"((uint32_t)v)); }
+#else
+    static constexpr uintptr_t kFlushBits = 0;
+    static uintptr_t Read() { return 0; }
+    static void Write(uintptr_t) {}
+#endif
+
+    bool enabled_;
+    uintptr_t saved_ = 0;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+// DSP load histogram: kDspLoadBuckets buckets of 1/kDspLoadBucketsPerBudget of
+// the period budget each, the last one also counting everything above 2x budget
+static constexpr uint32_t kDspLoadBucketsPerBudget = 64;
+static constexpr uint32_t kDspLoadBuckets = 2 * kDspLoadBucketsPerBudget;
+
+// Snapshot published by the audio thread after every callback. Load is the time
+// spent in the callback divided by the period's duration (frames / sampleRate):
+// 1.0 means the whole budget was used.
+struct DspStats
+{
+    uint64_t callbacks;
+    uint64_t frames;
+    uint64_t lateCallbacks; // started more than 1.5 periods after the previous one
+    uint64_t processErrors; // non-zero returns from libpd_process_float
+    double loadMin;
+    double loadMax;
+    double loadSum;
+    double lastLoad;
+    double lastBudgetUs;
+    uint32_t loadHistogram[kDspLoadBuckets];
+
+    double LoadMean() const { return callbacks ? loadSum / (double)callbacks : 0.0; }
+
+    // Upper edge of the histogram bucket holding the given quantile (0..1)
+    double LoadQuantile(double q) const
+    {
+        if (callbacks == 0)
+            return 0.0;
+        const uint64_t rank = (uint64_t)(q * (double)callbacks + 0.999999);
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < kDspLoadBuckets; ++i)
+        {
+            seen += loadHistogram[i];
+            if (seen >= rank)
+                return i + 1 == kDspLoadBuckets ? loadMax : (double)(i + 1) / kDspLoadBucketsPerBudget;
+        }
+        return loadMax;
+    }
+};
+
+// Audio-thread side: timestamps each callback with the monotonic clock and
+// accumulates DspStats. No allocation, no locks; publish Stats() through a
+// Seqlock for readers on other threads.
+class DspLoadMeter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void Reset()
+    {
+        memset(&stats_, 0, sizeof(stats_));
+        hasPrevious_ = false;
+    }
+
+    void Begin() { start_ = Clock::now(); }
+
+    void End(uint32_t frames, int sampleRate, uint64_t processErrors)
+    {
+        const Clock::time_point end = Clock::now();
+        const double budgetUs = sampleRate > 0 ? (double)frames * 1e6 / (double)sampleRate : 0.0;
+        const double elapsedUs = std::chrono::duration<double, std::micro>(end - start_).count();
+
+        if (hasPrevious_)
+        {
+            // Retard mesuré sur la période précédente, celle que le device vient de jouer
+            const double intervalUs = std::chrono::duration<double, std::micro>(start_ - previousStart_).count();
+            if (previousBudgetUs_ > 0.0 && intervalUs > 1.5 * previousBudgetUs_)
+                ++stats_.lateCallbacks;
+        }
+        hasPrevious_ = true;
+        previousStart_ = start_;
+        previousBudgetUs_ = budgetUs;
+
+        const double load = budgetUs > 0.0 ? elapsedUs / budgetUs : 0.0;
+        if (stats_.callbacks == 0 || load < stats_.loadMin)
+            stats_.loadMin = load;
+        if (load > stats_.loadMax)
+            stats_.loadMax = load;
+        stats_.loadSum += load;
+        stats_.lastLoad = load;
+        stats_.lastBudgetUs = budgetUs;
+        uint32_t bucket = (uint32_t)(load * kDspLoadBucketsPerBudget);
+        if (bucket >= kDspLoadBuckets)
+            bucket = kDspLoadBuckets - 1;
+        ++stats_.loadHistogram[bucket];
+
+        ++stats_.callbacks;
+        stats_.frames += frames;
+        stats_.processErrors = processErrors;
+    }
+
+    const DspStats &Stats() const { return stats_; }
+
+private:
+    DspStats stats_{};
+    Clock::time_point start_{};
+    Clock::time_point previousStart_{};
+    double previousBudgetUs_ = 0.0;
+    bool hasPrevious_ = false;
+};
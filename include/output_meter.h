@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+#include "seqlock.h"
+#include "simd_gain.h"
+#include "true_peak.h"
+
+// Levels of one metering window, per channel, in linear amplitude
+struct MeterSnapshot
+{
+    uint64_t windows; // windows published so far, 0 before the first one
+    uint32_t channels;
+    uint32_t frames; // frames in this window
+    float peak[kMeterMaxChannels];
+    float rms[kMeterMaxChannels];
+    float truePeak[kMeterMaxChannels]; // 0 unless true-peak metering is on
+};
+
+// SharedArrayBuffer mirror of the snapshot (engine.createMeterView): seq is an
+// Int32 sequence word JS reads with Atomics (odd while a window is written),
+// windows an Int32 counter, values holds peak, rms then truePeak for each channel.
+struct MeterMirror
+{
+    std::atomic<int32_t> *seq;
+    std::atomic<int32_t> *windows;
+    std::atomic<float> *values;
+    uint32_t channels;
+};
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "Int32Array slots must map to std::atomic<int32_t>");
+static_assert(sizeof(std::atomic<float>) == sizeof(float), "Float32Array slots must map to std::atomic<float>");
+
+// Output meter fed by the audio thread with what ApplyGainMetered measured: it
+// piles levels up over a window of frames, then publishes them in one seqlock
+// store (and the mirror, if any). The true-peak filter runs over the period just
+// written, while it is still in cache, only when enabled.
+class OutputMeter
+{
+public:
+    // Before the audio thread starts
+    void Configure(uint32_t channels, uint32_t windowFrames, bool truePeak)
+    {
+        channels_ = channels;
+        metered_ = channels < kMeterMaxChannels ? channels : kMeterMaxChannels;
+        windowFrames_ = windowFrames > 0 ? windowFrames : 1;
+        truePeak_ = truePeak;
+        truePeakMeter_.Reset();
+        Clear();
+    }
+
+    bool TruePeak() const { return truePeak_; }
+
+    // Audio thread
+    void Add(const float *out, uint32_t frames, const ChannelLevels &levels)
+    {
+        for (uint32_t ch = 0; ch < metered_; ++ch)
+        {
+            if (levels.peak[ch] > peak_[ch])
+                peak_[ch] = levels.peak[ch];
+            sum_[ch] += levels.sumSquares[ch];
+        }
+        if (truePeak_)
+            truePeakMeter_.Process(out, frames, channels_, truePeakAcc_);
+        frames_ += frames;
+        if (frames_ >= windowFrames_)
+            Publish();
+    }
+
+    // Any thread
+    MeterSnapshot Load() const { return snapshot_.Load(); }
+
+    // JS thread, once: the mirror must outlive the meter
+    void AttachMirror(MeterMirror *mirror) { mirror_.store(mirror, std::memory_order_release); }
+    bool HasMirror() const { return mirror_.load(std::memory_order_relaxed) != nullptr; }
+
+private:
+    void Publish()
+    {
+        MeterSnapshot s{};
+        s.windows = ++windows_;
+        s.channels = metered_;
+        s.frames = frames_;
+        for (uint32_t ch = 0; ch < metered_; ++ch)
+        {
+            s.peak[ch] = peak_[ch];
+            s.rms[ch] = (float)std::sqrt(sum_[ch] / frames_);
+            // Jamais sous le pic échantillon (le filtre atténue de 0,2 dB au plus)
+            if (truePeak_)
+                s.truePeak[ch] = truePeakAcc_[ch] > peak_[ch] ? truePeakAcc_[ch] : peak_[ch];
+        }
+        snapshot_.Store(s);
+
+        if (MeterMirror *m = mirror_.load(std::memory_order_acquire))
+        {
+            const uint32_t n = m->channels < metered_ ? m->channels : metered_;
+            const int32_t seq = m->seq->load(std::memory_order_relaxed);
+            m->seq->store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (uint32_t ch = 0; ch < n; ++ch)
+            {
+                m->values[ch].store(s.peak[ch], std::memory_order_relaxed);
+                m->values[m->channels + ch].store(s.rms[ch], std::memory_order_relaxed);
+                m->values[2 * m->channels + ch].store(s.truePeak[ch], std::memory_order_relaxed);
+            }
+            m->windows->store((int32_t)(s.windows & 0x7fffffff), std::memory_order_relaxed);
+            m->seq->store(seq + 2, std::memory_order_release);
+        }
+        Clear();
+    }
+
+    void Clear()
+    {
+        for (uint32_t ch = 0; ch < kMeterMaxChannels; ++ch)
+        {
+            peak_[ch] = 0.0f;
+            sum_[ch] = 0.0;
+            truePeakAcc_[ch] = 0.0f;
+        }
+        frames_ = 0;
+    }
+
+    uint32_t channels_ = 0;
+    uint32_t metered_ = 0;
+    uint32_t windowFrames_ = 1;
+    bool truePeak_ = false;
+    uint32_t frames_ = 0;
+    uint64_t windows_ = 0;
+    float peak_[kMeterMaxChannels] = {};
+    double sum_[kMeterMaxChannels] = {};
+    float truePeakAcc_[kMeterMaxChannels] = {};
+    TruePeakMeter truePeakMeter_;
+    Seqlock<MeterSnapshot> snapshot_;
+    std::atomic<MeterMirror *> mirror_{nullptr};
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "pd_command.h"
+
+// Native side of a parameter block (engine.createParamBlock): count Float32 values
+// and Int32 generation counters living in a SharedArrayBuffer that JS threads
+// write with plain stores + Atomics.add. The DSP thread compares each counter with
+// the last one it saw and forwards only the changed slots to their receivers.
+// A writer racing with the scan at worst causes the new value to be sent twice.
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t) && sizeof(std::atomic<float>) == sizeof(float),
+              "shared memory slots are accessed as std::atomic");
+
+struct ParamBlock
+{
+    const std::atomic<int32_t> *generations = nullptr;
+    const std::atomic<float> *values = nullptr;
+    uint32_t count = 0;
+    std::unique_ptr<PdReceiverHandle *[]> handles; // engine-owned, see receiver()
+    std::unique_ptr<int32_t[]> seen;               // DSP side
+};
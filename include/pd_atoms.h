@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Compact atom list encoding shared by queued messages: each atom is a one-byte
+// tag followed by a float32 ('f') or a NUL-terminated string ('s'). Records are
+// fixed-size, so a list that does not fit in the payload is truncated.
+
+constexpr size_t kPdAtomPayloadSize = 240;
+// Borne sur le nombre d'atomes d'un payload (symboles vides : 2 octets chacun)
+constexpr size_t kPdMaxAtoms = kPdAtomPayloadSize / 2;
+constexpr uint8_t kPdAtomFloat = 'f';
+constexpr uint8_t kPdAtomSymbol = 's';
+
+class PdAtomWriter
+{
+public:
+    PdAtomWriter(uint8_t *buf, size_t capacity) : buf_(buf), capacity_(capacity) {}
+
+    bool AddFloat(float f)
+    {
+        if (size_ + 1 + sizeof(float) > capacity_)
+            return false;
+        buf_[size_++] = kPdAtomFloat;
+        std::memcpy(buf_ + size_, &f, sizeof(float));
+        size_ += sizeof(float);
+        ++count_;
+        return true;
+    }
+
+    bool AddSymbol(const char *s)
+    {
+        return AddSymbol(s, std::strlen(s));
+    }
+
+    bool AddSymbol(const char *s, size_t length)
+    {
+        if (size_ + 1 + length + 1 > capacity_)
+            return false;
+        buf_[size_++] = kPdAtomSymbol;
+        std::memcpy(buf_ + size_, s, length);
+        size_ += length;
+        buf_[size_++] = '\0';
+        ++count_;
+        return true;
+    }
+
+    size_t Size() const { return size_; }
+    uint8_t Count() const { return count_; }
+
+private:
+    uint8_t *buf_;
+    size_t capacity_;
+    size_t size_ = 0;
+    uint8_t count_ = 0;
+};
+
+struct PdAtomView
+{
+    bool isSymbol;
+    float f;
+    const char *s;
+};
+
+class PdAtomReader
+{
+public:
+    PdAtomReader(const uint8_t *buf, size_t size) : buf_(buf), size_(size) {}
+
+    bool Next(PdAtomView &atom)
+    {
+        if (pos_ >= size_)
+            return false;
+        const uint8_t tag = buf_[pos_++];
+        if (tag == kPdAtomFloat && pos_ + sizeof(float) <= size_)
+        {
+            atom.isSymbol = false;
+            std::memcpy(&atom.f, buf_ + pos_, sizeof(float));
+            atom.s = nullptr;
+            pos_ += sizeof(float);
+            return true;
+        }
+        if (tag == kPdAtomSymbol)
+        {
+            const void *end = std::memchr(buf_ + pos_, '\0', size_ - pos_);
+            if (!end)
+                return false;
+            atom.isSymbol = true;
+            atom.f = 0.0f;
+            atom.s = reinterpret_cast<const char *>(buf_ + pos_);
+            pos_ = (size_t)(static_cast<const uint8_t *>(end) - buf_) + 1;
+            return true;
+        }
+        pos_ = size_; // encodage invalide : on s'arrête là
+        return false;
+    }
+
+private:
+    const uint8_t *buf_;
+    size_t size_;
+    size_t pos_ = 0;
+};
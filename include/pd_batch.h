@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "pd_command.h"
+
+// Binary command batch accepted by engine.sendBatch() and produced by js/batch.js.
+// A batch is a sequence of byte-packed little-endian records:
+//
+//   u8   type     0 bang, 1 float, 2 symbol, 3 list (PdCommandType)
+//   u8   flags    bit 0: timed
+//   u16  size     record size in bytes, this header included
+//   f64  time     only when timed: Pd sample clock value (send*At)
+//   u8   length   receiver name length, then the name (no NUL)
+//   body          float: f32 | symbol: u8 length + bytes | list: u8 argc + atoms
+//
+// List atoms use the pd_atoms.h encoding ('f' + f32, 's' + NUL-terminated string)
+// and run to the end of the record, so they are copied into the command as is.
+
+constexpr uint8_t kPdBatchTimed = 0x01;
+constexpr size_t kPdBatchHeaderSize = 4;
+
+// Decodes the record at p (avail bytes left) into cmd. Returns the record size, or
+// 0 if it is malformed or does not fit. Only the fields the type uses are written.
+inline size_t DecodePdBatchRecord(const uint8_t *p, size_t avail, PdCommand &cmd)
+{
+    if (avail < kPdBatchHeaderSize)
+        return 0;
+    const uint8_t type = p[0];
+    const uint8_t flags = p[1];
+    uint16_t size;
+    std::memcpy(&size, p + 2, sizeof(size));
+    if (size < kPdBatchHeaderSize + 1 || size > avail || type > (uint8_t)PdCommandType::List)
+        return 0;
+
+    size_t pos = kPdBatchHeaderSize;
+    cmd.type = (PdCommandType)type;
+    cmd.time = 0;
+    if (flags & kPdBatchTimed)
+    {
+        if (pos + sizeof(double) > size)
+            return 0;
+        double t;
+        std::memcpy(&t, p + pos, sizeof(t));
+        pos += sizeof(t);
+        // NaN, ±inf et 2^64 ou plus n'ont pas de conversion définie en uint64_t
+        if (!(t > -HUGE_VAL && t < 18446744073709551616.0))
+            return 0;
+        cmd.time = t > 0.0 ? (uint64_t)t : 0;
+    }
+
+    if (pos + 1 > size)
+        return 0;
+    const size_t recvLength = p[pos++];
+    if (pos + recvLength > size || !CopyPdName(cmd.receiver, reinterpret_cast<const char *>(p + pos), recvLength))
+        return 0;
+    pos += recvLength;
+
+    switch (cmd.type)
+    {
+    case PdCommandType::Bang:
+        break;
+    case PdCommandType::Float:
+        if (pos + sizeof(float) > size)
+            return 0;
+        std::memcpy(&cmd.value, p + pos, sizeof(float));
+        pos += sizeof(float);
+        break;
+    case PdCommandType::Symbol:
+    {
+        if (pos + 1 > size)
+            return 0;
+        const size_t length = p[pos++];
+        if (pos + length > size || !CopyPdName(cmd.symbol, reinterpret_cast<const char *>(p + pos), length))
+            return 0;
+        pos += length;
+        break;
+    }
+    default: // List
+    {
+        if (pos + 1 > size)
+            return 0;
+        cmd.argc = p[pos++];
+        const size_t length = size - pos;
+        if (length > sizeof(cmd.payload))
+            return 0;
+        std::memcpy(cmd.payload, p + pos, length);
+        cmd.size = (uint16_t)length;
+        pos = size;
+        break;
+    }
+    }
+    return pos == size ? size : 0;
+}
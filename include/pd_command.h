@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "pd_atoms.h"
+
+// Longueur max (NUL compris) des noms de receivers et des symboles transportés
+// dans une commande ; au-delà, l'appel JS est rejeté
+constexpr size_t kPdMaxNameLength = 64;
+
+enum class PdCommandType : uint8_t
+{
+    Bang,
+    Float,
+    Symbol,
+    List,   // argc atoms encoded in payload (pd_atoms.h)
+    HandleBang,  // bang to the PdReceiverHandle in ptr
+    HandleFloat, // float to the PdReceiverHandle in ptr
+    Bind,   // libpd_bind(receiver), handle stored in *(void **)ptr
+    Unbind, // libpd_unbind(*(void **)ptr)
+    // MIDI into Pd: libpd channel in midi[0], then the data (pd_midi.h)
+    NoteOn,         // pitch, velocity
+    ControlChange,  // controller, value
+    ProgramChange,  // program
+    PitchBend,      // -8192..8191
+    Aftertouch,     // value
+    PolyAftertouch, // pitch, value
+    MidiBytes,      // port in midi[0], size raw bytes in payload ([midiin], [sysexin])
+};
+
+// Fixed-size control message queued from the JS thread to the audio thread.
+// A non-zero time is the Pd sample clock value at which it is due (send*At).
+struct PdCommand
+{
+    PdCommandType type;
+    uint8_t argc;  // List
+    uint16_t size; // octets utilisés dans payload (List)
+    float value;
+    uint64_t time;
+    void *ptr;
+    int32_t midi[3];
+    char receiver[kPdMaxNameLength];
+    char symbol[kPdMaxNameLength];
+    uint8_t payload[kPdAtomPayloadSize];
+};
+
+// Receiver pre-registered with engine.receiver(name). Owned by the engine for its
+// whole lifetime so queued commands can point at it; symbol is the resolved
+// t_symbol *, filled by the DSP side on first use and never touched by JS. Symbols
+// belong to a Pd instance: epoch tells which one it was resolved in (reloadPatch).
+struct PdReceiverHandle
+{
+    char name[kPdMaxNameLength];
+    void *symbol;
+    uint32_t epoch;
+};
+
+// Copie une chaîne dans un champ fixe, false si elle ne tient pas
+inline bool CopyPdName(char (&dst)[kPdMaxNameLength], const char *src, size_t length)
+{
+    if (length >= kPdMaxNameLength)
+        return false;
+    std::memcpy(dst, src, length);
+    dst[length] = '\0';
+    return true;
+}
+
+// Variante pour le thread audio : tronque au lieu d'échouer
+inline void CopyPdNameTruncated(char (&dst)[kPdMaxNameLength], const char *src)
+{
+    size_t i = 0;
+    for (; i + 1 < kPdMaxNameLength && src[i] != '\0'; ++i)
+        dst[i] = src[i];
+    dst[i] = '\0';
+}
@@ -1,18 +1,60 @@
 #pragma once
 
 #include <napi.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "aligned_buffer.h"
+#include "dsp_stats.h"
+#include "output_meter.h"
+#include "param_block.h"
+#include "pd_request.h"
+#include "pd_command.h"
+#include "pd_message.h"
+#include "pd_midi.h"
+#include "rt_semaphore.h"
+#include "rt_thread.h"
+#include "seqlock.h"
+#include "spsc_byte_ring.h"
+#include "spsc_frame_ring.h"
+#include "spsc_queue.h"
+#include "tick_fifo.h"
+#include "timed_queue.h"
+
 #ifdef HAVE_MINIAUDIO
 // Forward declare global miniaudio types
 struct ma_device;
 #endif
 
+// t_atom (m_pd.h), pour les signatures des hooks libpd
+struct _atom;
+// t_pdinstance (m_pd.h)
+struct _pdinstance;
+// État d'un reloadPatch (pd_engine.cc)
+struct PdReload;
+// Prise de sortie ouverte par tap() (pd_engine.cc)
+struct PdTap;
+
+// Constructeurs de l'addon, un jeu par environnement (env.SetInstanceData dans addon.cc)
+struct PdAddonData
+{
+    Napi::FunctionReference engine;
+    Napi::FunctionReference receiver;
+};
+
 class PdEngine : public Napi::ObjectWrap<PdEngine>
 {
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    // True only for objects built by the PdEngine constructor: Unwrap() alone
+    // accepts any wrapped object (a PdMixer, a PdReceiver...)
+    static bool IsInstance(Napi::Env env, Napi::Value value);
     ~PdEngine();
     PdEngine(const Napi::CallbackInfo &info);
 
@@ -25,27 +67,387 @@ private:
     Napi::Value stop(const Napi::CallbackInfo &info);
     Napi::Value openPatch(const Napi::CallbackInfo &info);
     Napi::Value closePatch(const Napi::CallbackInfo &info);
+    Napi::Value openPatchAsync(const Napi::CallbackInfo &info);
+    Napi::Value closePatchAsync(const Napi::CallbackInfo &info);
+    Napi::Value reloadPatch(const Napi::CallbackInfo &info);
     Napi::Value sendBang(const Napi::CallbackInfo &info);
     Napi::Value sendFloat(const Napi::CallbackInfo &info);
     Napi::Value sendSymbol(const Napi::CallbackInfo &info);
+    Napi::Value sendList(const Napi::CallbackInfo &info);
+    Napi::Value sendBangAt(const Napi::CallbackInfo &info);
+    Napi::Value sendFloatAt(const Napi::CallbackInfo &info);
+    Napi::Value sendSymbolAt(const Napi::CallbackInfo &info);
+    Napi::Value sendListAt(const Napi::CallbackInfo &info);
+    Napi::Value sendBatch(const Napi::CallbackInfo &info);
+    Napi::Value sendNoteOn(const Napi::CallbackInfo &info);
+    Napi::Value sendCC(const Napi::CallbackInfo &info);
+    Napi::Value sendProgramChange(const Napi::CallbackInfo &info);
+    Napi::Value sendPitchBend(const Napi::CallbackInfo &info);
+    Napi::Value sendAftertouch(const Napi::CallbackInfo &info);
+    Napi::Value sendPolyAftertouch(const Napi::CallbackInfo &info);
+    Napi::Value sendMidiBytes(const Napi::CallbackInfo &info);
+    Napi::Value sendMidiBatch(const Napi::CallbackInfo &info);
+    Napi::Value receiver(const Napi::CallbackInfo &info);
+    Napi::Value attachParamBlock(const Napi::CallbackInfo &info);
+    Napi::Value arraySize(const Napi::CallbackInfo &info);
+    Napi::Value readArray(const Napi::CallbackInfo &info);
+    Napi::Value writeArray(const Napi::CallbackInfo &info);
+    Napi::Value resizeArray(const Napi::CallbackInfo &info);
+    Napi::Value loadArray(const Napi::CallbackInfo &info);
+    Napi::Value getSampleTime(const Napi::CallbackInfo &info);
+    Napi::Value getLatency(const Napi::CallbackInfo &info);
+    Napi::Value getStats(const Napi::CallbackInfo &info);
+    Napi::Value getMeters(const Napi::CallbackInfo &info);
+    Napi::Value attachMeterBuffer(const Napi::CallbackInfo &info);
+    Napi::Value setGain(const Napi::CallbackInfo &info);
+    Napi::Value setClip(const Napi::CallbackInfo &info);
+    Napi::Value setRenderAhead(const Napi::CallbackInfo &info);
+    Napi::Value getRenderWatermark(const Napi::CallbackInfo &info);
+    Napi::Value getRealtimeStatus(const Napi::CallbackInfo &info);
+    Napi::Value render(const Napi::CallbackInfo &info);
+    Napi::Value renderAsync(const Napi::CallbackInfo &info);
+    Napi::Value on(const Napi::CallbackInfo &info);
+    Napi::Value off(const Napi::CallbackInfo &info);
+    Napi::Value onMidi(const Napi::CallbackInfo &info);
+    Napi::Value offMidi(const Napi::CallbackInfo &info);
+    Napi::Value onPrint(const Napi::CallbackInfo &info);
+    Napi::Value offPrint(const Napi::CallbackInfo &info);
+    Napi::Value tap(const Napi::CallbackInfo &info);
+    Napi::Value untap(const Napi::CallbackInfo &info);
+
+    // Taille fixe d'un tick PureData
+    static constexpr uint32_t kPdBlockSize = 64;
+    // Avance maximale du thread de rendu, en périodes
+    static constexpr int kMaxRenderAhead = 16;
 
     // State
     bool running_ = false;
+    bool dspActive_ = false; // libpd owned by the audio/render thread (JS thread only)
     int sampleRate_ = 48000;
     int blockSize_ = 64;
     int channelsOut_ = 2;
     int channelsIn_ = 0;
+    int commandQueueSize_ = 1024;
+    int messageQueueSize_ = 1024;
+    int scheduleQueueSize_ = 1024;
+    int midiQueueSize_ = 1024;
+    int printQueueSize_ = 65536;
+    int printRate_ = 200;
 
 #ifdef HAVE_MINIAUDIO
+    // Each engine owns its device; device_ is set while it runs
+    std::unique_ptr<::ma_device> deviceStorage_;
     ::ma_device *device_ = nullptr;
 #endif
 
 #ifdef HAVE_LIBPD
+    // Each engine owns a Pd instance (libpd built with PDINSTANCE/PDTHREADS). The
+    // current instance is thread-local in libpd: every thread selects instance_
+    // (SelectInstance) before touching libpd. Without PDINSTANCE, the main
+    // instance is used and only one engine may exist at a time.
+    struct _pdinstance *instance_ = nullptr;
+    bool ownsMainInstance_ = false;
     void *patch_ = nullptr; // libpd patch handle
 #endif
+    // Offline rendering (render/renderAsync): no device, AudioCallback driven in a
+    // loop. offlineReady_ keeps the tick FIFO between calls so consecutive renders
+    // are continuous; offlineBusy_ is set while renderAsync owns libpd.
+    bool offlineReady_ = false;
+    bool offlineBusy_ = false;
+    friend class OfflineRenderWorker;
+
+    // PdMixer membership: while attached, the mixer's device callback or one of
+    // its workers renders this engine into mixOut_ (RenderForMixer) instead of a
+    // device of its own
+    friend class PdMixer;
+    bool mixerAttached_ = false;
+    AlignedBuffer<float> mixOut_;
+
     // simple oscillator fallback when libpd is not available
     double phase_ = 0.0;
+
+    // Audio-thread scratch, sized in start() and reused by every callback so the
+    // hot path never touches the heap. Whole ticks are rendered straight into the
+    // device buffer; a trailing partial tick goes through tickScratch_ and its
+    // unused frames wait in tickFifo_ for the next period.
+    AlignedBuffer<float> tickScratch_;
+    TickFifo tickFifo_;
+
+    // Capture side (duplex): the current period's input, how much of it the
+    // ticks already consumed, and what is left over for the next period
+    AlignedBuffer<float> inScratch_;
+    TickFifo inFifo_;
+    const float *periodIn_ = nullptr;
+    uint32_t periodInFrames_ = 0;
+    uint32_t periodInPos_ = 0;
+
+    // Output stage: master gain set from JS, ramped from currentGain_ (audio
+    // thread only) to targetGain_ over each period; optional hard clip to [-1, 1]
+    std::atomic<float> targetGain_{0.8f};
+    std::atomic<bool> clip_{false};
+    float currentGain_ = 0.8f;
+
+    // Output tap (tap()): the thread producing the device output copies it, post
+    // gain, into tap_'s ring. tap_ is swapped by the JS thread only; tapHazard_
+    // marks the tap the audio side is writing to, so untap() frees it only once
+    // that thread has let go of it.
+    std::atomic<PdTap *> tap_{nullptr};
+    std::atomic<PdTap *> tapHazard_{nullptr};
+
+    // Output metering (metering option): the gain pass measures the output as it
+    // writes it (ApplyGainMetered) and meter_ publishes peak, RMS and optionally
+    // true peak every meterWindowMs_ for getMeters() and createMeterView(). Off
+    // unless asked for: the device callback pays for it on every period
+    bool metering_ = false;
+    bool truePeak_ = false;
+    int meterWindowMs_ = 50;
+    OutputMeter meter_;
+    std::unique_ptr<MeterMirror> meterMirror_;
+    std::vector<Napi::ObjectReference> meterMirrorRefs_;
+
+    // Render-ahead mode (renderThread option): a dedicated thread renders Pd ticks
+    // into renderRing_ up to renderTargetFrames_ ahead of the device, which only
+    // copies out. The callback tracks the lowest fill level it has seen.
+    bool renderThread_ = false;
+    int renderAhead_ = 2;
+    uint32_t renderPeriodFrames_ = 0; // device period, set at start() once known
+    SpscFrameRing renderRing_;
+    std::thread renderWorker_;
+    std::atomic<bool> renderStop_{false};
+    std::atomic<uint32_t> renderTargetFrames_{0};
+    std::atomic<uint32_t> renderLowWater_{UINT32_MAX};
+    std::atomic<uint64_t> renderUnderruns_{0};
+    RtSemaphore renderSem_;
+
+    // Real-time scheduling / memory locking requests. The audio callback applies
+    // rtOptions_ to its own thread on the first period (rtSetupPending_ is only
+    // touched by that thread once the device runs), the render thread on start.
+    RtThreadOptions rtOptions_;
+    bool lockMemory_ = false;
+    int memoryLockStatus_ = kRtNotRequested;
+    bool rtSetupPending_ = false;
+    RtThreadStatus audioThreadStatus_;
+    RtThreadStatus renderThreadStatus_;
+
+    // FTZ/DAZ on the DSP thread while it renders (denormalProtection option)
+    bool denormalProtection_ = true;
+
+    // Deadline instrumentation: the audio thread times every callback into
+    // dspMeter_ and publishes a copy through dspStats_ for getStats(). RenderTick
+    // counts libpd errors from whichever thread owns libpd.
+    DspLoadMeter dspMeter_;
+    Seqlock<DspStats> dspStats_;
+    std::atomic<uint64_t> processErrors_{0};
+
+    // Latency bookkeeping published by the audio thread for getLatency()
+    std::atomic<uint32_t> lastPeriodFrames_{0};
+    std::atomic<uint32_t> fifoFrames_{0};
+
+    // Control messages from the JS thread (producer) to the audio thread
+    // (consumer), drained at the start of every Pd tick
+    SpscQueue<PdCommand> commands_;
+    std::atomic<uint64_t> commandOverflows_{0};
+
+    // Handles returned by receiver(name), one per name, freed with the engine
+    friend class PdReceiver;
+    std::unordered_map<std::string, std::unique_ptr<PdReceiverHandle>> receivers_;
+
+    // Shared-memory parameter blocks, scanned by the DSP thread before every tick.
+    // Slots are published in order with a release store and live as long as the
+    // engine (the typed-array references keep the SharedArrayBuffer alive).
+    static constexpr int kMaxParamBlocks = 16;
+    std::atomic<ParamBlock *> paramBlocks_[kMaxParamBlocks] = {};
+    std::vector<std::unique_ptr<ParamBlock>> paramBlockStorage_;
+    std::vector<Napi::ObjectReference> paramBlockRefs_;
+    std::atomic<uint64_t> paramDispatches_{0};
+
+    // Array and patch requests: requesters (JS thread, background workers) take
+    // turns publishing one PdRequest in request_ and block on its semaphore; the
+    // DSP thread runs it between two ticks, so a table is never half written and
+    // the graph never changes while Pd renders. Without a DSP thread, the JS
+    // thread runs it: in place for its own requests, from the worker's progress
+    // callback otherwise, and when it takes libpd back (stop, mixer stop, end of
+    // renderAsync).
+    static constexpr uint32_t kRequestTimeoutMs = 2000;
+    static constexpr uint32_t kWorkerTimeoutMs = 10000;
+    static constexpr uint32_t kArrayLoadChunk = 65536;
+    template <typename T>
+    friend class PdRequestWorker;
+    friend class ArrayLoadWorker;
+    friend class PatchWorker;
+    std::atomic<PdRequest *> request_{nullptr};
+    RtSemaphore requestDone_; // JS thread requests
+    std::atomic<uint64_t> arrayOps_{0};
+    std::atomic<uint64_t> arrayLoadedSamples_{0};
+    std::atomic<uint32_t> arrayLoads_{0};
+
+    // reloadPatch: a worker prepares a spare instance, the DSP thread swaps it in
+    // at a tick boundary and renders both for fadeFrames_, mixing the retired one
+    // (fadeInstance_) out with an equal-power curve, then posts fadeDone_ so the
+    // worker frees it. Listener (un)binds wait for the end of the reload
+    // (reloadTouched_); receiver handles re-resolve their symbol when
+    // instanceEpoch_ moves. fade* and instanceEpoch_ belong to the DSP side.
+    friend class ReloadWorker;
+    bool reloading_ = false;
+    std::vector<std::string> reloadTouched_;
+    std::atomic<uint64_t> reloads_{0};
+    uint32_t instanceEpoch_ = 0;
+    struct _pdinstance *fadeInstance_ = nullptr;
+    uint32_t fadeFrames_ = 0;
+    uint32_t fadePos_ = 0;
+    RtSemaphore *fadeDone_ = nullptr;
+    AlignedBuffer<float> fadeScratch_;
+
+    // Time the thread owning libpd spent opening or closing patches or resizing
+    // arrays, i.e. with the DSP graph held (written by that thread, read by getStats)
+    std::atomic<uint64_t> graphChanges_{0};
+    std::atomic<uint64_t> arrayResizes_{0};
+    std::atomic<uint64_t> graphHoldTotalUs_{0};
+    std::atomic<uint32_t> graphHoldLastUs_{0};
+    std::atomic<uint32_t> graphHoldMaxUs_{0};
+
+    // Sample clock: frames rendered by Pd since the engine was created, advanced
+    // one tick at a time by the DSP thread and published for getSampleTime().
+    // Timed commands wait in scheduled_ (DSP side) and are dispatched right before
+    // the 64-sample tick that contains their time.
+    uint64_t sampleTime_ = 0;
+    std::atomic<uint64_t> sampleClock_{0};
+    TimedQueue<PdCommand> scheduled_;
+    std::atomic<uint64_t> scheduledDrops_{0};
+    std::atomic<uint32_t> scheduledPending_{0};
+
+    // Receive path: libpd hooks (audio thread) fill messages_, a notifier thread
+    // wakes the event loop through a single ThreadSafeFunction, and
+    // DeliverMessages() drains the whole ring once per event-loop turn.
+    struct Listener
+    {
+        std::vector<Napi::FunctionReference> callbacks;
+        void *binding = nullptr; // libpd_bind handle, only touched on the DSP side
+    };
+    std::unordered_map<std::string, std::unique_ptr<Listener>> listeners_;
+    SpscQueue<PdMessage> messages_;
+    std::atomic<uint64_t> messageDrops_{0};
+    std::atomic<bool> notifyPending_{false};
+    std::atomic<bool> notifyStop_{false};
+    RtSemaphore notifySem_;
+    std::thread notifyThread_;
+    Napi::ThreadSafeFunction tsfn_;
+
+    // MIDI out of Pd: the libpd MIDI hooks stamp each event with the tick's
+    // sample time into midiOut_ (only while onMidi() has listeners) and share the
+    // notifier above; DeliverMidi() hands everything pending to each callback as
+    // one pair of typed arrays.
+    SpscQueue<PdMidiEvent> midiOut_;
+    std::atomic<uint64_t> midiDrops_{0};
+    std::atomic<bool> midiListening_{false};
+    std::vector<Napi::FunctionReference> midiCallbacks_;
+
+    // Pd console ([print], errors), for onPrint(): the print hook assembles
+    // lines in printLine_ (DSP side) and pushes them into printRing_ without ever
+    // waiting. printThread_ drains it every kPrintDrainMs, coalesces repeated
+    // lines, keeps at most printRate_ new lines per second and passes the rest on
+    // to the notifier through printOut_ (u32 count, then the text).
+    static constexpr uint32_t kPrintDrainMs = 20;
+    static constexpr size_t kPrintLineMax = 1024;
+    SpscByteRing printRing_;
+    SpscByteRing printOut_;
+    char printLine_[kPrintLineMax];
+    size_t printLineLength_ = 0;
+    std::atomic<bool> printListening_{false};
+    std::atomic<uint64_t> printDrops_{0};
+    std::atomic<uint64_t> printSuppressed_{0};
+    std::atomic<uint64_t> printCoalesced_{0};
+    std::atomic<bool> printStop_{false};
+    RtSemaphore printSem_;
+    std::thread printThread_;
+    std::vector<Napi::FunctionReference> printCallbacks_;
+
     // Internal helpers (no N-API usage)
     void StopInternal();
+    void AllocateBuffers();
+    void StartDsp();
+    bool PrepareOfflineRender(const Napi::CallbackInfo &info, Napi::Float32Array &out, uint32_t &frames);
+    void RenderOffline(float *out, uint32_t frames);
+    void FinishOfflineRender();
+    bool AttachMixer(Napi::Env env, uint32_t maxFrames);
+    void DetachMixer();
+    void SetMixerRunning(bool running);
+    const float *RenderForMixer(uint32_t frames);
+    void AudioCallback(float *out, const float *in, uint32_t frameCount);
+    const float *TickInput();
+    int RenderTick(const float *in, float *out);
+    void RenderThreadMain();
+    void StopRenderThread();
+    void AllocateRenderAhead(uint32_t periodFrames);
+    void SetRenderAheadPeriods(int periods);
+    void PlayRendered(float *out, uint32_t frameCount);
+    void TapOutput(const float *out, uint32_t frameCount);
+    void CloseTap();
+    bool DspThreadActive() const;
+    bool PostCommand(const PdCommand &cmd);
+    bool PostHandle(PdCommandType type, PdReceiverHandle *handle, float value, uint64_t time);
+    Napi::Value SendCommand(const Napi::CallbackInfo &info, PdCommandType type, bool timed);
+    Napi::Value SendMidi(const Napi::CallbackInfo &info, PdCommandType type);
+    bool PostMidi(uint8_t status, uint8_t data1, uint8_t data2, uint64_t time);
+    void DrainCommands();
+    void Schedule(const PdCommand &cmd);
+    void DispatchScheduled();
+    void ScanParamBlocks();
+    void RunRequest(bool rendering);
+    void ReclaimDsp();
+    void ServiceRequests();
+    bool PostRequest(PdRequest &op, uint32_t timeoutMs);
+    bool WaitRequest(PdRequest &op, uint32_t timeoutMs);
+    bool SyncRequest(Napi::Env env, PdRequest &op);
+    bool ArrayRequest(Napi::Env env, PdRequest &op);
+    void ExecuteRequest(PdRequest &op, bool rendering);
+    void RecordGraphHold(std::chrono::steady_clock::time_point begin);
+    void SwapInstance(PdReload &reload, bool rendering);
+    void CrossfadeTick(const float *in, float *out);
+    void EndCrossfade();
+    void BeginReload(PdReload &reload);
+    void EndReload(const PdReload &reload);
+    PdReceiverHandle *ReceiverHandle(const std::string &name);
+    void DispatchCommand(const PdCommand &cmd);
+    bool InitPd();
+    void InitInstanceAudio();
+    static void InstallHooks();
+    void SelectInstance() const;
+    void StartNotifier(Napi::Env env);
+    void StopNotifier();
+    PdMessage *BeginMessage(PdMessageType type, const char *recv);
+    void CommitMessage();
+    void DeliverMessages(Napi::Env env);
+    void PushMidi(uint8_t status, int data1, int data2, int port);
+    bool DeliverMidi(Napi::Env env);
+    void StartPrintDrain();
+    void StopPrintDrain();
+    void PrintDrainMain();
+    void PushPrint(const char *s);
+    bool DeliverPrint(Napi::Env env);
+
+    // libpd hooks, routed to the engine through libpd_get_instancedata()
+    static void PdBangHook(const char *recv);
+    static void PdFloatHook(const char *recv, float x);
+    static void PdSymbolHook(const char *recv, const char *sym);
+    static void PdListHook(const char *recv, int argc, struct _atom *argv);
+    static void PdMessageHook(const char *recv, const char *msg, int argc, struct _atom *argv);
+    static void PdPrintHook(const char *s);
+    static void PushChannelMessage(uint8_t kind, int channel, int data1, int data2);
+    static void PdNoteOnHook(int channel, int pitch, int velocity);
+    static void PdControlChangeHook(int channel, int controller, int value);
+    static void PdProgramChangeHook(int channel, int value);
+    static void PdPitchBendHook(int channel, int value);
+    static void PdAftertouchHook(int channel, int value);
+    static void PdPolyAftertouchHook(int channel, int pitch, int value);
+    static void PdMidiByteHook(int port, int byte);
     static void splitPath(const std::string &full, std::string &dir, std::string &name);
 };
+
+// getStats().dsp, shared by PdEngine and PdMixer
+Napi::Object DspStatsObject(Napi::Env env, const DspStats &stats);
+
+// schedPolicy / schedPriority / cpuAffinity options, and the status object of a
+// thread that applied them, shared by PdEngine and PdMixer
+void ParseRtThreadOptions(Napi::Object options, RtThreadOptions &rt);
+Napi::Object RtThreadObject(Napi::Env env, const RtThreadStatus &status);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include "pd_atoms.h"
+#include "pd_command.h"
+
+enum class PdMessageType : uint8_t
+{
+    Bang,
+    Float,
+    Symbol,
+    List,
+    Message,
+};
+
+// Fixed-size message produced by the libpd hooks on the audio thread and
+// delivered to JS listeners registered with engine.on(receiver, cb).
+struct PdMessage
+{
+    PdMessageType type;
+    uint8_t argc;     // nombre d'atomes encodés dans payload (List/Message)
+    uint16_t size;    // octets utilisés dans payload
+    float value;      // Float
+    char receiver[kPdMaxNameLength];
+    char symbol[kPdMaxNameLength]; // valeur du Symbol, ou sélecteur du Message
+    uint8_t payload[kPdAtomPayloadSize];
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pd_command.h"
+
+// libpd MIDI channels: 16 per port, port = channel / 16 (PdMidiEvent::port is a byte)
+constexpr int kPdMidiChannels = 16 * 256;
+
+// Outbound MIDI captured by the libpd MIDI hooks ([noteout], [ctlout], [midiout],
+// ...) on the DSP thread and delivered to engine.onMidi() listeners in batches.
+// status/data1/data2 form a channel voice message (channel in the low nibble),
+// or status is 0 and data1 the raw byte for [midiout]. port is the Pd channel
+// divided by 16.
+struct PdMidiEvent
+{
+    uint64_t time; // Pd sample clock at the start of the tick that produced it
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint8_t port;
+};
+
+// Length of a channel voice message with this status byte, 0 if it is not one
+inline size_t MidiMessageLength(uint8_t status)
+{
+    switch (status & 0xF0)
+    {
+    case 0x80:
+    case 0x90:
+    case 0xA0:
+    case 0xB0:
+    case 0xE0:
+        return 3;
+    case 0xC0:
+    case 0xD0:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+// Channel voice message to a MIDI command (libpd channel = port * 16 + channel).
+// Note off becomes a note on with velocity 0, as Pd's [notein] reports it.
+inline void DecodeMidiMessage(uint8_t status, uint8_t data1, uint8_t data2, int port, PdCommand &cmd)
+{
+    cmd.midi[0] = (status & 0x0F) + 16 * port;
+    cmd.midi[1] = data1 & 0x7F;
+    cmd.midi[2] = data2 & 0x7F;
+    switch (status & 0xF0)
+    {
+    case 0x80:
+        cmd.type = PdCommandType::NoteOn;
+        cmd.midi[2] = 0;
+        break;
+    case 0x90:
+        cmd.type = PdCommandType::NoteOn;
+        break;
+    case 0xA0:
+        cmd.type = PdCommandType::PolyAftertouch;
+        break;
+    case 0xB0:
+        cmd.type = PdCommandType::ControlChange;
+        break;
+    case 0xC0:
+        cmd.type = PdCommandType::ProgramChange;
+        break;
+    case 0xD0:
+        cmd.type = PdCommandType::Aftertouch;
+        break;
+    default: // 0xE0, 14 bits centrés sur 0 comme libpd_pitchbend
+        cmd.type = PdCommandType::PitchBend;
+        cmd.midi[1] = (((data2 & 0x7F) << 7) | (data1 & 0x7F)) - 8192;
+        break;
+    }
+}
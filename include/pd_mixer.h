@@ -0,0 +1,142 @@
+#pragma once
+
+#include <napi.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "aligned_buffer.h"
+#include "dsp_stats.h"
+#include "rt_semaphore.h"
+#include "rt_thread.h"
+#include "seqlock.h"
+
+#ifdef HAVE_MINIAUDIO
+struct ma_device;
+#endif
+
+class PdEngine;
+
+// One output device for many PdEngine instances. Every period the device callback
+// renders all attached engines, in parallel on a pool of worker threads when more
+// than one is attached, then sums their outputs into the device buffer.
+//
+// Scheduling: engines are sorted by their recent cost (longest first) and dealt
+// round-robin into one slice per participant (the device thread and each worker).
+// A participant claims tasks from its own slice with an atomic counter, then steals
+// from the others' counters once its slice is empty. The device thread waits for
+// the last claimed task before mixing: it spins for kMaxSpins rounds, then sleeps
+// on doneSem_ until the worker finishing the last task posts it. With a single
+// engine, no workers, or a worker still busy from the previous period, the period
+// is rendered inline instead. Workers and the device thread apply the mixer's
+// real-time options (schedPolicy, schedPriority, cpuAffinity) when they start.
+class PdMixer : public Napi::ObjectWrap<PdMixer>
+{
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    PdMixer(const Napi::CallbackInfo &info);
+    ~PdMixer();
+
+private:
+    // JS methods
+    Napi::Value add(const Napi::CallbackInfo &info);
+    Napi::Value remove(const Napi::CallbackInfo &info);
+    Napi::Value start(const Napi::CallbackInfo &info);
+    Napi::Value stop(const Napi::CallbackInfo &info);
+    Napi::Value setClip(const Napi::CallbackInfo &info);
+    Napi::Value getStats(const Napi::CallbackInfo &info);
+
+    // Largest period rendered in one go; longer device periods are split
+    static constexpr uint32_t kMaxChunkFrames = 4096;
+    static constexpr int kMaxWorkers = 63;
+    static constexpr uint32_t kMaxSpins = 1024;
+
+    // An attached engine. Cost figures are written by whichever thread rendered it
+    // last; the period hand-off (semaphores, pending_) orders those writes.
+    struct Slot
+    {
+        PdEngine *engine = nullptr;
+        Napi::ObjectReference ref;
+        const float *out = nullptr;
+        float avgUs = 0.0f; // smoothed cost, used for scheduling
+        std::atomic<float> lastUs{0.0f};
+        std::atomic<float> meanUs{0.0f};
+        std::atomic<float> maxUs{0.0f};
+        std::atomic<uint64_t> renders{0};
+    };
+
+    // A participant's share of the period: tasks_[begin, end), next claims
+    struct alignas(kCacheLineSize) Slice
+    {
+        std::atomic<uint32_t> next{0};
+        uint32_t end = 0;
+    };
+
+    struct Worker
+    {
+        uint32_t index = 0;
+        RtSemaphore wake;
+        RtThreadStatus status;
+        std::thread thread;
+    };
+
+    // Config
+    int sampleRate_ = 48000;
+    int blockSize_ = 256;
+    int channelsOut_ = 2;
+    int workerCount_ = 0;
+    std::atomic<bool> clip_{false};
+    bool running_ = false;
+
+    // Real-time requests: the device thread applies them on its first period
+    // (rtSetupPending_ is only touched by that thread once the device runs), each
+    // worker when it starts
+    RtThreadOptions rtOptions_;
+    bool rtSetupPending_ = false;
+    RtThreadStatus deviceThreadStatus_;
+
+    // FTZ/DAZ on the device thread and the workers while they render
+    // (denormalProtection option). It replaces the engines' own setting: they
+    // render on the mixer's threads.
+    bool denormalProtection_ = true;
+
+#ifdef HAVE_MINIAUDIO
+    std::unique_ptr<::ma_device> device_;
+#endif
+
+    // Attached engines; only changed while stopped
+    std::vector<std::unique_ptr<Slot>> slots_;
+
+    // Period state, written by the device thread before waking the workers
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unique_ptr<Slice[]> slices_;
+    std::vector<uint32_t> order_;
+    std::vector<uint32_t> tasks_;
+    uint32_t sliceCount_ = 0;
+    uint32_t periodFrames_ = 0;
+    std::atomic<uint32_t> pending_{0};      // tasks not finished yet this period
+    std::atomic<uint32_t> busyWorkers_{0};  // woken workers not back to sleep yet
+    std::atomic<bool> stopWorkers_{false};
+    std::atomic<bool> deviceWaiting_{false}; // device thread asleep on doneSem_
+    RtSemaphore doneSem_;
+
+    // Stats
+    DspLoadMeter dspMeter_;
+    Seqlock<DspStats> dspStats_;
+    std::atomic<uint64_t> parallelPeriods_{0};
+    std::atomic<uint64_t> inlinePeriods_{0};
+
+    // Internal helpers (no N-API usage)
+    void AudioCallback(float *out, uint32_t frameCount);
+    void RenderPeriod(uint32_t frames);
+    void RenderSlot(Slot &slot, uint32_t frames);
+    void Participate(uint32_t self);
+    void FinishTask();
+    void WaitForTasks();
+    void WorkerMain(Worker *worker);
+    void StartWorkers();
+    void StopWorkers();
+    void StopInternal();
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <napi.h>
+#include <cstdint>
+
+#include "pd_command.h"
+
+class PdEngine;
+
+// Handle returned by engine.receiver(name). The name is copied and resolved once;
+// set()/bang() then push a pointer-sized command (handle + value) without any
+// string conversion, and the DSP side sends straight to the cached t_symbol.
+// Keeps its engine alive.
+class PdReceiver : public Napi::ObjectWrap<PdReceiver>
+{
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    static Napi::Object New(Napi::Env env, Napi::Object engine, PdReceiverHandle *handle);
+    PdReceiver(const Napi::CallbackInfo &info);
+
+private:
+    // JS methods
+    Napi::Value set(const Napi::CallbackInfo &info);
+    Napi::Value bang(const Napi::CallbackInfo &info);
+    Napi::Value getName(const Napi::CallbackInfo &info);
+
+    bool ReadTime(const Napi::CallbackInfo &info, size_t index, uint64_t &time);
+
+    PdEngine *engine_ = nullptr;
+    Napi::ObjectReference engineRef_;
+    PdReceiverHandle *handle_ = nullptr;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "pd_command.h"
+
+class RtSemaphore;
+
+enum class PdRequestType : uint8_t
+{
+    ArraySize,    // result = libpd_arraysize(name)
+    ArrayRead,    // libpd_read_array(data, name, offset, count)
+    ArrayWrite,   // libpd_write_array(name, offset, data, count)
+    ArrayResize,  // libpd_resize_array(name, count)
+    OpenPatch,    // patch = libpd_openfile(file, dir)
+    ClosePatch,   // libpd_closefile(patch)
+    SwapInstance, // reloadPatch: switch to the prepared instance in context
+};
+
+// Request handed from the JS thread or a background worker to whichever thread
+// owns libpd, which runs it between two ticks and posts done once result is set.
+// Array requests: data points straight into the caller's memory, so samples are
+// copied once, between the Pd array and that memory. result follows libpd: >= 0
+// on success (the size for ArraySize), -1 not found, -2 range out of bounds.
+// Patch requests: dir and file belong to the requester; result is -1 if the
+// patch could not be opened. SwapInstance: context is the PdReload being applied.
+struct PdRequest
+{
+    PdRequestType type;
+    char name[kPdMaxNameLength];
+    float *data;
+    int offset;
+    int count;
+    int result;
+    const char *dir;
+    const char *file;
+    void *patch;
+    void *context;
+    RtSemaphore *done;
+};
+
+constexpr int kPdArrayNotFound = -1;
+constexpr int kPdArrayOutOfRange = -2;
@@ -0,0 +1,31 @@
+#pragma once
+
+// Debug aid for the real-time path. When the addon is configured with
+// -DWITH_RT_ALLOC_CHECK=ON (which defines PD_RT_ALLOC_CHECK), every operator
+// new/delete issued by this addon while an RtAllocScope is alive on the current
+// thread aborts the process with a message, so a debugger or core dump points at
+// the offending allocation. Allocations made inside libpd itself (C malloc) are
+// not intercepted. In regular builds RtAllocScope compiles to nothing.
+
+#ifdef PD_RT_ALLOC_CHECK
+namespace rt_alloc
+{
+void EnterRealtime();
+void LeaveRealtime();
+}
+
+class RtAllocScope
+{
+public:
+    RtAllocScope() { rt_alloc::EnterRealtime(); }
+    ~RtAllocScope() { rt_alloc::LeaveRealtime(); }
+    RtAllocScope(const RtAllocScope &) = delete;
+    RtAllocScope &operator=(const RtAllocScope &) = delete;
+};
+#else
+class RtAllocScope
+{
+public:
+    RtAllocScope() {}
+};
+#endif
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <climits>
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <semaphore.h>
+#endif
+
+// Counting semaphore used to wake non-real-time threads from the audio thread.
+// Post() is a single atomic operation plus, at most, a kernel wake-up: it never
+// takes a lock and is safe to call from the audio callback. Wait()/WaitFor() are
+// for the waiting (non-RT) side only.
+class RtSemaphore
+{
+public:
+    RtSemaphore()
+    {
+#if defined(_WIN32)
+        handle_ = CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr);
+#elif defined(__APPLE__)
+        sem_ = dispatch_semaphore_create(0);
+#else
+        sem_init(&sem_, 0, 0);
+#endif
+    }
+
+    ~RtSemaphore()
+    {
+#if defined(_WIN32)
+        CloseHandle(handle_);
+#elif defined(__APPLE__)
+        dispatch_release(sem_);
+#else
+        sem_destroy(&sem_);
+#endif
+    }
+
+    RtSemaphore(const RtSemaphore &) = delete;
+    RtSemaphore &operator=(const RtSemaphore &) = delete;
+
+    void Post()
+    {
+#if defined(_WIN32)
+        ReleaseSemaphore(handle_, 1, nullptr);
+#elif defined(__APPLE__)
+        dispatch_semaphore_signal(sem_);
+#else
+        sem_post(&sem_);
+#endif
+    }
+
+    void Wait()
+    {
+#if defined(_WIN32)
+        WaitForSingleObject(handle_, INFINITE);
+#elif defined(__APPLE__)
+        dispatch_semaphore_wait(sem_, DISPATCH_TIME_FOREVER);
+#else
+        while (sem_wait(&sem_) != 0 && errno == EINTR)
+        {
+        }
+#endif
+    }
+
+    // Retourne false si le délai expire avant un Post()
+    bool WaitFor(uint32_t timeoutMs)
+    {
+#if defined(_WIN32)
+        return WaitForSingleObject(handle_, timeoutMs) == WAIT_OBJECT_0;
+#elif defined(__APPLE__)
+        return dispatch_semaphore_wait(sem_, dispatch_time(DISPATCH_TIME_NOW, (int64_t)timeoutMs * 1000000)) == 0;
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += timeoutMs / 1000;
+        ts.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000000000L;
+        }
+        int rc;
+        while ((rc = sem_timedwait(&sem_, &ts)) != 0 && errno == EINTR)
+        {
+        }
+        return rc == 0;
+#endif
+    }
+
+private:
+#if defined(_WIN32)
+    HANDLE handle_;
+#elif defined(__APPLE__)
+    dispatch_semaphore_t sem_;
+#else
+    sem_t sem_;
+#endif
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+// Real-time scheduling requests for the audio/render threads. Only implemented on
+// Linux; elsewhere every request reports ENOTSUP. Status codes are 0 on success,
+// an errno value on failure (typically EPERM without CAP_SYS_NICE / CAP_IPC_LOCK),
+// or kRtNotRequested.
+
+constexpr int kRtNotRequested = -1;
+constexpr int kRtMaxCpus = 64;
+
+enum class RtSchedPolicy
+{
+    Default,
+    Fifo,
+    RoundRobin,
+};
+
+struct RtThreadOptions
+{
+    RtSchedPolicy policy = RtSchedPolicy::Default;
+    int priority = 0;
+    int cpus[kRtMaxCpus] = {};
+    int cpuCount = 0;
+};
+
+// Résultat publié par le thread concerné, lu depuis le thread JS
+struct RtThreadStatus
+{
+    std::atomic<bool> applied{false};
+    std::atomic<int> sched{kRtNotRequested};
+    std::atomic<int> affinity{kRtNotRequested};
+};
+
+// Applies policy/priority and CPU affinity to the calling thread. Makes a couple
+// of system calls, so call it once when the thread starts, not per period.
+void ApplyRtThreadOptions(const RtThreadOptions &options, RtThreadStatus &status);
+
+// mlockall(MCL_CURRENT | MCL_FUTURE) for the whole process; 0 or errno
+int LockProcessMemory();
+
+// Spin-wait hint for short waits between real-time threads (pause / yield)
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "aligned_buffer.h"
+
+// Single-writer sequence lock for publishing a small snapshot from the audio
+// thread. Store() never blocks or allocates: it bumps the sequence to odd, writes
+// the payload, then bumps it back to even. Load() copies the payload and retries
+// while a write was in progress or happened meanwhile, so readers always see a
+// consistent value without the writer ever waiting on them. The payload is kept
+// as relaxed atomic words so a torn read is a retry, not a data race.
+template <typename T>
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock payloads must be trivially copyable");
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+public:
+    Seqlock() = default;
+    Seqlock(const Seqlock &) = delete;
+    Seqlock &operator=(const Seqlock &) = delete;
+
+    // Writer side (one thread at a time)
+    void Store(const T &value)
+    {
+        uint32_t words[kWords] = {};
+        memcpy(words, &value, sizeof(T));
+        const uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i)
+            data_[i].store(words[i], std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    // Reader side (any thread)
+    T Load() const
+    {
+        uint32_t words[kWords];
+        for (;;)
+        {
+            const uint32_t before = seq_.load(std::memory_order_acquire);
+            if (before & 1u)
+                continue;
+            for (size_t i = 0; i < kWords; ++i)
+                words[i] = data_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == before)
+                break;
+        }
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    alignas(kCacheLineSize) std::atomic<uint32_t> seq_{0};
+    std::atomic<uint32_t> data_[kWords]{};
+};
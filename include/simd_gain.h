@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Output stage of the audio callback: dst[i] = src[i] * gain over `count`
+// interleaved samples (a whole number of frames of `channels` channels), with the
+// gain ramping linearly per frame from gainStart (first frame) towards gainEnd
+// (reached after the last frame), so every channel of a frame gets the same gain,
+// and an optional hard clip to [-1, 1]. src and dst may alias. The implementation
+// (SSE2, AVX2, NEON or scalar) is picked once at load time from what the CPU
+// supports.
+void ApplyGain(float *dst, const float *src, size_t count, float gainStart, float gainEnd, bool clip,
+               uint32_t channels);
+
+// Output levels per channel of an interleaved buffer, accumulated by
+// ApplyGainMetered: largest |x| and sum of x^2. Channels past the 16th are not
+// measured.
+constexpr uint32_t kMeterMaxChannels = 16;
+struct ChannelLevels
+{
+    float peak[kMeterMaxChannels];
+    float sumSquares[kMeterMaxChannels];
+};
+
+// ApplyGain that also measures the samples it writes into levels (added to what
+// is already there). The vector kernels measure in the same pass when channels
+// divides their width or is a multiple of it (1, 2, 4, 8, 16, 32... channels);
+// other layouts apply the vector gain, then measure in a second pass.
+void ApplyGainMetered(float *dst, const float *src, size_t count, float gainStart, float gainEnd, bool clip,
+                      uint32_t channels, ChannelLevels &levels);
+
+// Mixer bus: dst[i] += src[i] * gain, with the same runtime-selected instruction
+// set as ApplyGain. src and dst must not overlap.
+void MixAdd(float *dst, const float *src, size_t count, float gain);
+
+// Nom du noyau sélectionné ("avx2", "sse2", "neon" ou "scalar")
+const char *GainKernelName();
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "aligned_buffer.h"
+
+// Lock-free single-producer/single-consumer ring of variable-length byte records
+// (a u16 length, then the bytes), for text that would waste a fixed-size slot per
+// entry. A record is written whole or not at all, and may wrap around the end of
+// the buffer. Capacity is rounded up to a power of two bytes by Allocate(), which
+// must run before either side starts.
+class SpscByteRing
+{
+public:
+    static constexpr size_t kMaxRecord = 0xffff;
+
+    void Allocate(size_t minCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < minCapacity)
+            capacity <<= 1;
+        capacity_ = capacity;
+        buf_.Allocate(capacity);
+        readPos_.store(0, std::memory_order_relaxed);
+        writePos_.store(0, std::memory_order_relaxed);
+    }
+
+    size_t Capacity() const { return capacity_; }
+
+    // Octets occupés (exact côté consommateur)
+    size_t UsedBytes() const
+    {
+        return writePos_.load(std::memory_order_acquire) - readPos_.load(std::memory_order_acquire);
+    }
+
+    // Producer: false if the record does not fit in the free space
+    bool Push(const void *data, size_t length)
+    {
+        if (length > kMaxRecord)
+            return false;
+        const size_t pos = writePos_.load(std::memory_order_relaxed);
+        if (capacity_ - (pos - readPos_.load(std::memory_order_acquire)) < sizeof(uint16_t) + length)
+            return false;
+        const uint16_t size = (uint16_t)length;
+        CopyIn(pos, &size, sizeof(size));
+        CopyIn(pos + sizeof(size), data, length);
+        writePos_.store(pos + sizeof(size) + length, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: copies the next record into dst (truncated to `capacity` bytes)
+    // and returns its full length in `length`; false if the ring is empty
+    bool Pop(void *dst, size_t capacity, size_t &length)
+    {
+        const size_t pos = readPos_.load(std::memory_order_relaxed);
+        if (writePos_.load(std::memory_order_acquire) == pos)
+            return false;
+        uint16_t size;
+        CopyOut(pos, &size, sizeof(size));
+        length = size;
+        CopyOut(pos + sizeof(size), dst, length < capacity ? length : capacity);
+        readPos_.store(pos + sizeof(size) + length, std::memory_order_release);
+        return true;
+    }
+
+private:
+    void CopyIn(size_t pos, const void *src, size_t n)
+    {
+        const size_t start = pos & (capacity_ - 1);
+        const size_t first = n < capacity_ - start ? n : capacity_ - start;
+        std::memcpy(buf_.Data() + start, src, first);
+        std::memcpy(buf_.Data(), static_cast<const uint8_t *>(src) + first, n - first);
+    }
+
+    void CopyOut(size_t pos, void *dst, size_t n) const
+    {
+        const size_t start = pos & (capacity_ - 1);
+        const size_t first = n < capacity_ - start ? n : capacity_ - start;
+        std::memcpy(dst, buf_.Data() + start, first);
+        std::memcpy(static_cast<uint8_t *>(dst) + first, buf_.Data(), n - first);
+    }
+
+    alignas(kCacheLineSize) std::atomic<size_t> readPos_{0};
+    alignas(kCacheLineSize) std::atomic<size_t> writePos_{0};
+    alignas(kCacheLineSize) AlignedBuffer<uint8_t> buf_;
+    size_t capacity_ = 0;
+};
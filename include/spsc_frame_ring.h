@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "aligned_buffer.h"
+
+// Lock-free single-producer/single-consumer ring of interleaved float frames.
+// Unlike SpscQueue, reads and writes move any number of frames at once, and the
+// consumer can access the readable data in place (at most two contiguous
+// segments) to fuse the copy with other processing. Capacity is rounded up to a
+// power of two frames by Allocate(), which must run before either side starts.
+class SpscFrameRing
+{
+public:
+    void Allocate(uint32_t channels, uint32_t minCapacityFrames)
+    {
+        uint32_t capacity = 1;
+        while (capacity < minCapacityFrames)
+            capacity <<= 1;
+        channels_ = channels;
+        capacity_ = capacity;
+        buf_.Allocate((size_t)capacity * channels);
+        readPos_.store(0, std::memory_order_relaxed);
+        writePos_.store(0, std::memory_order_relaxed);
+    }
+
+    uint32_t Channels() const { return channels_; }
+    uint32_t CapacityFrames() const { return capacity_; }
+
+    // Frames prêtes à lire (exact côté consommateur)
+    uint32_t ReadableFrames() const
+    {
+        return (uint32_t)(writePos_.load(std::memory_order_acquire) - readPos_.load(std::memory_order_relaxed));
+    }
+
+    // Place libre (exact côté producteur)
+    uint32_t WritableFrames() const
+    {
+        return capacity_ - (uint32_t)(writePos_.load(std::memory_order_relaxed) - readPos_.load(std::memory_order_acquire));
+    }
+
+    // Producer: copies up to `frames` frames, returns how many fitted
+    uint32_t Write(const float *src, uint32_t frames)
+    {
+        const uint32_t space = WritableFrames();
+        if (frames > space)
+            frames = space;
+        if (frames == 0)
+            return 0;
+        const size_t pos = writePos_.load(std::memory_order_relaxed);
+        const uint32_t start = (uint32_t)(pos & (capacity_ - 1));
+        uint32_t first = capacity_ - start;
+        if (first > frames)
+            first = frames;
+        std::memcpy(buf_.Data() + (size_t)start * channels_, src, (size_t)first * channels_ * sizeof(float));
+        if (frames > first)
+            std::memcpy(buf_.Data(), src + (size_t)first * channels_, (size_t)(frames - first) * channels_ * sizeof(float));
+        writePos_.store(pos + frames, std::memory_order_release);
+        return frames;
+    }
+
+    // Producer: like Write(), from frames of srcChannels (>= Channels()) channels
+    // of which only the first Channels() are kept
+    uint32_t WriteChannels(const float *src, uint32_t srcChannels, uint32_t frames)
+    {
+        if (srcChannels == channels_)
+            return Write(src, frames);
+        const uint32_t space = WritableFrames();
+        if (frames > space)
+            frames = space;
+        const size_t pos = writePos_.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            float *dst = buf_.Data() + (size_t)((pos + i) & (capacity_ - 1)) * channels_;
+            std::memcpy(dst, src + (size_t)i * srcChannels, (size_t)channels_ * sizeof(float));
+        }
+        writePos_.store(pos + frames, std::memory_order_release);
+        return frames;
+    }
+
+    // Consumer: exposes up to `frames` readable frames in place as two segments
+    // (the second one is empty unless the data wraps). Call Consume() afterwards.
+    uint32_t Peek(uint32_t frames, const float *&first, uint32_t &firstFrames,
+                  const float *&second, uint32_t &secondFrames) const
+    {
+        const uint32_t readable = ReadableFrames();
+        if (frames > readable)
+            frames = readable;
+        const uint32_t start = (uint32_t)(readPos_.load(std::memory_order_relaxed) & (capacity_ - 1));
+        firstFrames = capacity_ - start;
+        if (firstFrames > frames)
+            firstFrames = frames;
+        secondFrames = frames - firstFrames;
+        first = buf_.Data() + (size_t)start * channels_;
+        second = buf_.Data();
+        return frames;
+    }
+
+    void Consume(uint32_t frames)
+    {
+        readPos_.store(readPos_.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    }
+
+    // Consumer: copies up to `frames` frames out, returns how many were read
+    uint32_t Read(float *dst, uint32_t frames)
+    {
+        const float *a;
+        const float *b;
+        uint32_t na, nb;
+        frames = Peek(frames, a, na, b, nb);
+        std::memcpy(dst, a, (size_t)na * channels_ * sizeof(float));
+        if (nb > 0)
+            std::memcpy(dst + (size_t)na * channels_, b, (size_t)nb * channels_ * sizeof(float));
+        Consume(frames);
+        return frames;
+    }
+
+private:
+    alignas(kCacheLineSize) std::atomic<size_t> readPos_{0};
+    alignas(kCacheLineSize) std::atomic<size_t> writePos_{0};
+    alignas(kCacheLineSize) AlignedBuffer<float> buf_;
+    uint32_t channels_ = 0;
+    uint32_t capacity_ = 0;
+};
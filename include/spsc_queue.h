@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include "aligned_buffer.h"
+
+// Wait-free single-producer/single-consumer ring of fixed-size records.
+// Capacity is fixed by Allocate() (rounded up to a power of two) before either
+// side starts using the queue; TryPush/TryPop never block, never allocate and
+// simply fail when the ring is full/empty. Head and tail live on their own cache
+// lines, and each side keeps a cached copy of the other's index so the shared
+// line is only touched when the cache says full/empty.
+template <typename T>
+class SpscQueue
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue records must be trivially copyable");
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Not thread-safe: call before the producer and consumer threads use the queue
+    void Allocate(size_t minCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < minCapacity)
+            capacity <<= 1;
+        slots_.Allocate(capacity);
+        mask_ = capacity - 1;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        headCache_ = 0;
+        tailCache_ = 0;
+    }
+
+    size_t Capacity() const { return slots_.Size(); }
+
+    // Approximate when called concurrently, exact from either side when the other is idle
+    size_t SizeApprox() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    // Producer side
+    bool TryPush(const T &item)
+    {
+        T *slot = BeginPush();
+        if (!slot)
+            return false;
+        *slot = item;
+        CommitPush();
+        return true;
+    }
+
+    // Producer side: reserve the next slot to fill in place, then CommitPush()
+    T *BeginPush()
+    {
+        if (slots_.Size() == 0)
+            return nullptr;
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ == slots_.Size())
+        {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ == slots_.Size())
+                return nullptr;
+        }
+        return &slots_.Data()[tail & mask_];
+    }
+
+    void CommitPush()
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side
+    bool TryPop(T &item)
+    {
+        const T *front = Front();
+        if (!front)
+            return false;
+        item = *front;
+        Pop();
+        return true;
+    }
+
+    // Consumer side: peek at the oldest record without copying it, then Pop()
+    const T *Front()
+    {
+        if (slots_.Size() == 0)
+            return nullptr;
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_)
+        {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_)
+                return nullptr;
+        }
+        return &slots_.Data()[head & mask_];
+    }
+
+    void Pop()
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    // Consumer-owned
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    size_t tailCache_ = 0;
+    // Producer-owned
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+    size_t headCache_ = 0;
+    // Shared, read-only after Allocate()
+    alignas(kCacheLineSize) AlignedBuffer<T> slots_;
+    size_t mask_ = 0;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "aligned_buffer.h"
+
+// Interleaved frame FIFO owned by the audio thread. It carries the tail of a
+// 64-sample Pd tick that did not fit in the current device period over to the
+// next callback, so any period size can be served from whole Pd ticks.
+// Single-threaded: only the audio callback reads or writes it.
+class TickFifo
+{
+public:
+    void Allocate(uint32_t channels, uint32_t capacityFrames)
+    {
+        channels_ = channels;
+        capacity_ = capacityFrames;
+        buf_.Allocate((size_t)channels * capacityFrames);
+        Clear();
+    }
+
+    void Clear()
+    {
+        readPos_ = 0;
+        frames_ = 0;
+    }
+
+    uint32_t Frames() const { return frames_; }
+    uint32_t Capacity() const { return capacity_; }
+
+    // Copie jusqu'à `frames` frames vers dst, retourne le nombre de frames lues
+    uint32_t Read(float *dst, uint32_t frames)
+    {
+        if (frames > frames_)
+            frames = frames_;
+        if (frames == 0)
+            return 0;
+        uint32_t first = capacity_ - readPos_;
+        if (first > frames)
+            first = frames;
+        std::memcpy(dst, buf_.Data() + (size_t)readPos_ * channels_, (size_t)first * channels_ * sizeof(float));
+        if (frames > first)
+            std::memcpy(dst + (size_t)first * channels_, buf_.Data(), (size_t)(frames - first) * channels_ * sizeof(float));
+        readPos_ = (readPos_ + frames) % capacity_;
+        frames_ -= frames;
+        return frames;
+    }
+
+    // Ajoute jusqu'à `frames` frames depuis src, retourne le nombre de frames écrites
+    uint32_t Write(const float *src, uint32_t frames)
+    {
+        if (frames > capacity_ - frames_)
+            frames = capacity_ - frames_;
+        if (frames == 0)
+            return 0;
+        uint32_t writePos = (readPos_ + frames_) % capacity_;
+        uint32_t first = capacity_ - writePos;
+        if (first > frames)
+            first = frames;
+        std::memcpy(buf_.Data() + (size_t)writePos * channels_, src, (size_t)first * channels_ * sizeof(float));
+        if (frames > first)
+            std::memcpy(buf_.Data(), src + (size_t)first * channels_, (size_t)(frames - first) * channels_ * sizeof(float));
+        frames_ += frames;
+        return frames;
+    }
+
+private:
+    AlignedBuffer<float> buf_;
+    uint32_t channels_ = 0;
+    uint32_t capacity_ = 0;
+    uint32_t readPos_ = 0;
+    uint32_t frames_ = 0;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "aligned_buffer.h"
+
+// Time-ordered queue owned by a single thread (the DSP thread): a binary min-heap
+// of small (time, sequence, slot) entries over a preallocated pool of records, so
+// heap moves never copy the records themselves. Items with equal times come out
+// in push order. Capacity is fixed by Allocate(); Push() fails when it is full and
+// nothing here allocates afterwards.
+template <typename T>
+class TimedQueue
+{
+    static_assert(std::is_trivially_copyable<T>::value, "TimedQueue records must be trivially copyable");
+
+public:
+    TimedQueue() = default;
+    TimedQueue(const TimedQueue &) = delete;
+    TimedQueue &operator=(const TimedQueue &) = delete;
+
+    void Allocate(size_t capacity)
+    {
+        pool_.Allocate(capacity);
+        heap_.Allocate(capacity);
+        free_.Allocate(capacity);
+        Clear();
+    }
+
+    void Clear()
+    {
+        size_ = 0;
+        for (size_t i = 0; i < free_.Size(); ++i)
+            free_.Data()[i] = (uint32_t)(free_.Size() - 1 - i);
+        freeCount_ = free_.Size();
+    }
+
+    size_t Size() const { return size_; }
+    size_t Capacity() const { return pool_.Size(); }
+
+    bool Push(uint64_t time, const T &item)
+    {
+        if (freeCount_ == 0)
+            return false;
+        const uint32_t slot = free_.Data()[--freeCount_];
+        pool_.Data()[slot] = item;
+        Entry *heap = heap_.Data();
+        size_t i = size_++;
+        const Entry entry{time, seq_++, slot};
+        while (i > 0)
+        {
+            const size_t parent = (i - 1) / 2;
+            if (!Before(entry, heap[parent]))
+                break;
+            heap[i] = heap[parent];
+            i = parent;
+        }
+        heap[i] = entry;
+        return true;
+    }
+
+    // Earliest item if it is due strictly before `limit`, nullptr otherwise
+    const T *Due(uint64_t limit) const
+    {
+        if (size_ == 0 || heap_.Data()[0].time >= limit)
+            return nullptr;
+        return &pool_.Data()[heap_.Data()[0].slot];
+    }
+
+    // Removes the earliest item
+    void Pop()
+    {
+        if (size_ == 0)
+            return;
+        Entry *heap = heap_.Data();
+        free_.Data()[freeCount_++] = heap[0].slot;
+        const Entry last = heap[--size_];
+        size_t i = 0;
+        for (;;)
+        {
+            size_t child = 2 * i + 1;
+            if (child >= size_)
+                break;
+            if (child + 1 < size_ && Before(heap[child + 1], heap[child]))
+                ++child;
+            if (!Before(heap[child], last))
+                break;
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = last;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t time;
+        uint64_t seq;
+        uint32_t slot;
+    };
+
+    static bool Before(const Entry &a, const Entry &b)
+    {
+        return a.time < b.time || (a.time == b.time && a.seq < b.seq);
+    }
+
+    AlignedBuffer<T> pool_;
+    AlignedBuffer<Entry> heap_;
+    AlignedBuffer<uint32_t> free_;
+    size_t size_ = 0;
+    size_t freeCount_ = 0;
+    uint64_t seq_ = 0;
+};
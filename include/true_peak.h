@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "simd_gain.h"
+
+// True-peak estimate of ITU-R BS.1770-4 (annex 2): each channel is upsampled 4x
+// with the standard 48-tap polyphase FIR (4 phases of 12 taps) and the largest
+// |x| of the interpolated signal is kept. The filter history carries over from
+// one period to the next. Audio thread only; nothing allocates.
+class TruePeakMeter
+{
+public:
+    static constexpr int kTaps = 12;
+    static constexpr int kPhases = 4;
+
+    void Reset()
+    {
+        std::memset(history_, 0, sizeof(history_));
+        pos_ = 0;
+    }
+
+    // Raises peak[ch] to the true peak of `frames` interleaved frames
+    void Process(const float *x, uint32_t frames, uint32_t channels, float *peak)
+    {
+        const uint32_t metered = channels < kMeterMaxChannels ? channels : kMeterMaxChannels;
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            pos_ = pos_ + 1 == kTaps ? 0 : pos_ + 1;
+            for (uint32_t ch = 0; ch < metered; ++ch)
+            {
+                // Historique doublé : les 12 derniers échantillons restent contigus,
+                // du plus ancien h[0] au plus récent h[11]
+                float *buf = history_[ch];
+                buf[pos_] = buf[pos_ + kTaps] = x[(size_t)f * channels + ch];
+                const float *h = buf + pos_ + 1;
+                float acc[kPhases] = {};
+                for (int k = 0; k < kTaps; ++k)
+                    for (int p = 0; p < kPhases; ++p)
+                        acc[p] += kCoeffs[p][k] * h[k];
+                float m = peak[ch];
+                for (int p = 0; p < kPhases; ++p)
+                    m = std::fabs(acc[p]) > m ? std::fabs(acc[p]) : m;
+                peak[ch] = m;
+            }
+        }
+    }
+
+private:
+    static constexpr float kCoeffs[kPhases][kTaps] = {
+        {0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f,
+         0.1373291015625f, 0.9721679687500f, -0.1022949218750f, 0.0476074218750f, -0.0266113281250f,
+         0.0148925781250f, -0.0083007812500f},
+        {-0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f,
+         0.4650878906250f, 0.7797851562500f, -0.2003173828125f, 0.1015625000000f, -0.0582275390625f,
+         0.0330810546875f, -0.0189208984375f},
+        {-0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f,
+         0.7797851562500f, 0.4650878906250f, -0.1665039062500f, 0.0891113281250f, -0.0517578125000f,
+         0.0292968750000f, -0.0291748046875f},
+        {-0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f,
+         0.9721679687500f, 0.1373291015625f, -0.0594482421875f, 0.0332031250000f, -0.0196533203125f,
+         0.0109863281250f, 0.0017089843750f},
+    };
+
+    float history_[kMeterMaxChannels][2 * kTaps] = {};
+    int pos_ = 0;
+};
@@ -71,4 +71,21 @@ const addon = bindings({
     module_root: __dirname,
 })
 
+// Encodeur JS pour engine.sendBatch()
+addon.PdBatch = require('./js/batch').PdBatch
+
+// Paramètres en mémoire partagée, relus par le thread audio
+const params = require('./js/params')
+addon.ParamBlock = params.ParamBlock
+addon.PdEngine.prototype.createParamBlock = function (names) {
+    return params.createParamBlock(this, names)
+}
+
+// Niveaux de sortie en mémoire partagée, écrits par le thread audio
+const meters = require('./js/meters')
+addon.MeterView = meters.MeterView
+addon.PdEngine.prototype.createMeterView = function () {
+    return meters.createMeterView(this)
+}
+
 module.exports = addon
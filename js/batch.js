@@ -0,0 +1,144 @@
+'use strict'
+
+// Encoder for engine.sendBatch(): packs many bang/float/symbol/list commands into
+// one ArrayBuffer so they cross into native code in a single call. The layout is
+// documented in include/pd_batch.h.
+
+const TYPE_BANG = 0
+const TYPE_FLOAT = 1
+const TYPE_SYMBOL = 2
+const TYPE_LIST = 3
+const FLAG_TIMED = 0x01
+const MAX_NAME = 63
+const MAX_RECORD = 0xffff
+
+const encoder = new TextEncoder()
+
+class PdBatch {
+    constructor(initialBytes = 4096) {
+        this._buffer = new ArrayBuffer(initialBytes)
+        this._bytes = new Uint8Array(this._buffer)
+        this._view = new DataView(this._buffer)
+        this._length = 0
+        this._count = 0
+        // Les noms de receivers reviennent sans cesse : encodés une seule fois
+        this._names = new Map()
+    }
+
+    get length() { return this._count }
+    get byteLength() { return this._length }
+
+    reset() {
+        this._length = 0
+        this._count = 0
+        return this
+    }
+
+    bang(receiver, sampleTime) {
+        this._begin(TYPE_BANG, receiver, sampleTime, 0)
+        return this._end()
+    }
+
+    float(receiver, value, sampleTime) {
+        this._begin(TYPE_FLOAT, receiver, sampleTime, 4)
+        this._view.setFloat32(this._length, value, true)
+        this._length += 4
+        return this._end()
+    }
+
+    symbol(receiver, symbol, sampleTime) {
+        const bytes = this._name(symbol)
+        this._begin(TYPE_SYMBOL, receiver, sampleTime, 1 + bytes.length)
+        this._bytes[this._length++] = bytes.length
+        this._bytes.set(bytes, this._length)
+        this._length += bytes.length
+        return this._end()
+    }
+
+    list(receiver, items, sampleTime) {
+        let size = 1
+        const encoded = new Array(items.length)
+        for (let i = 0; i < items.length; ++i) {
+            const item = items[i]
+            if (typeof item === 'number') {
+                size += 5
+            } else if (typeof item === 'string') {
+                encoded[i] = encoder.encode(item)
+                size += 2 + encoded[i].length
+            } else {
+                throw new TypeError('list items must be numbers or strings')
+            }
+        }
+        if (size - 1 > 240) throw new RangeError('list too long')
+        this._begin(TYPE_LIST, receiver, sampleTime, size)
+        this._bytes[this._length++] = items.length
+        for (let i = 0; i < items.length; ++i) {
+            if (encoded[i] === undefined) {
+                this._bytes[this._length++] = 0x66 // 'f'
+                this._view.setFloat32(this._length, items[i], true)
+                this._length += 4
+            } else {
+                this._bytes[this._length++] = 0x73 // 's'
+                this._bytes.set(encoded[i], this._length)
+                this._length += encoded[i].length
+                this._bytes[this._length++] = 0
+            }
+        }
+        return this._end()
+    }
+
+    // Vue sur les octets encodés, à passer à engine.sendBatch()
+    finish() {
+        return new Uint8Array(this._buffer, 0, this._length)
+    }
+
+    _name(name) {
+        let bytes = this._names.get(name)
+        if (bytes === undefined) {
+            bytes = encoder.encode(name)
+            if (bytes.length > MAX_NAME) throw new RangeError(`name too long: ${name}`)
+            if (this._names.size < 4096) this._names.set(name, bytes)
+        }
+        return bytes
+    }
+
+    _begin(type, receiver, sampleTime, bodySize) {
+        const name = this._name(receiver)
+        const timed = sampleTime !== undefined
+        const time = timed ? Number(sampleTime) : 0
+        if (!Number.isFinite(time) || time < 0) throw new RangeError(`invalid sample time: ${sampleTime}`)
+        const size = 4 + (timed ? 8 : 0) + 1 + name.length + bodySize
+        if (size > MAX_RECORD) throw new RangeError('record too large')
+        this._reserve(size)
+        const pos = this._length
+        this._bytes[pos] = type
+        this._bytes[pos + 1] = timed ? FLAG_TIMED : 0
+        this._view.setUint16(pos + 2, size, true)
+        this._length += 4
+        if (timed) {
+            this._view.setFloat64(this._length, time, true)
+            this._length += 8
+        }
+        this._bytes[this._length++] = name.length
+        this._bytes.set(name, this._length)
+        this._length += name.length
+    }
+
+    _end() {
+        this._count++
+        return this
+    }
+
+    _reserve(size) {
+        if (this._length + size <= this._buffer.byteLength) return
+        let capacity = this._buffer.byteLength * 2
+        while (capacity < this._length + size) capacity *= 2
+        const buffer = new ArrayBuffer(capacity)
+        new Uint8Array(buffer).set(this._bytes.subarray(0, this._length))
+        this._buffer = buffer
+        this._bytes = new Uint8Array(buffer)
+        this._view = new DataView(buffer)
+    }
+}
+
+module.exports = { PdBatch }
@@ -0,0 +1,54 @@
+'use strict'
+
+// Output meters mirrored into a SharedArrayBuffer by the audio thread, so a UI
+// (main thread, worker or renderer) can read them every frame without an N-API
+// call. Layout: Int32 [seq, windows], then Float32 peak, rms and truePeak for each
+// channel. seq is odd while a window is being written: read() retries until it
+// gets a consistent copy.
+
+class MeterView {
+    constructor(buffer, channels) {
+        if (buffer.byteLength < 8 + channels * 12) throw new RangeError('buffer too small for channels')
+        this.buffer = buffer
+        this.channels = channels
+        this.header = new Int32Array(buffer, 0, 2)
+        this.values = new Float32Array(buffer, 8, channels * 3)
+        this.peak = new Float32Array(channels)
+        this.rms = new Float32Array(channels)
+        this.truePeak = new Float32Array(channels)
+        this.windows = 0
+    }
+
+    // Rebuilds a view in another thread from { buffer, channels } sent via postMessage
+    static from(buffer, channels) {
+        return new MeterView(buffer, channels)
+    }
+
+    // Copies the last window into peak/rms/truePeak; false if none was published
+    // since the previous call
+    read() {
+        const n = this.channels
+        for (;;) {
+            const seq = Atomics.load(this.header, 0)
+            if (seq & 1) continue
+            const windows = this.header[1]
+            this.peak.set(this.values.subarray(0, n))
+            this.rms.set(this.values.subarray(n, 2 * n))
+            this.truePeak.set(this.values.subarray(2 * n, 3 * n))
+            if (Atomics.load(this.header, 0) !== seq) continue
+            const fresh = windows !== this.windows
+            this.windows = windows
+            return fresh
+        }
+    }
+}
+
+function createMeterView(engine) {
+    const buffer = new SharedArrayBuffer(8 + 16 * 12)
+    const header = new Int32Array(buffer, 0, 2)
+    const values = new Float32Array(buffer, 8, 16 * 3)
+    const channels = engine.attachMeterBuffer(header, values)
+    return new MeterView(buffer, channels)
+}
+
+module.exports = { MeterView, createMeterView }
@@ -0,0 +1,60 @@
+'use strict'
+
+// Parameter block: Float32 values and Int32 generation counters in one
+// SharedArrayBuffer. Writers (the main thread or any worker_thread) store a value
+// then bump its counter; the DSP thread polls the counters before every 64-sample
+// tick and forwards the changed values to their receivers. No N-API call per write.
+
+class ParamBlock {
+    constructor(buffer, names) {
+        const count = names.length
+        if (buffer.byteLength < count * 8) throw new RangeError('buffer too small for names')
+        this.buffer = buffer
+        this.names = names.slice()
+        this.values = new Float32Array(buffer, 0, count)
+        this.generations = new Int32Array(buffer, count * 4, count)
+        this._index = new Map()
+        for (let i = 0; i < count; ++i) this._index.set(this.names[i], i)
+    }
+
+    // Rebuilds a view in another thread from { buffer, names } sent via postMessage
+    static from(buffer, names) {
+        return new ParamBlock(buffer, names)
+    }
+
+    get length() { return this.values.length }
+
+    indexOf(name) {
+        const i = this._index.get(name)
+        return i === undefined ? -1 : i
+    }
+
+    set(nameOrIndex, value) {
+        const i = this._slot(nameOrIndex)
+        this.values[i] = value
+        // Publie la valeur : le thread DSP relit le compteur avec acquire
+        Atomics.add(this.generations, i, 1)
+        return this
+    }
+
+    get(nameOrIndex) {
+        return this.values[this._slot(nameOrIndex)]
+    }
+
+    _slot(nameOrIndex) {
+        const i = typeof nameOrIndex === 'number' ? nameOrIndex : this._index.get(nameOrIndex)
+        if (i === undefined || !(i >= 0 && i < this.values.length)) {
+            throw new RangeError(`unknown parameter: ${nameOrIndex}`)
+        }
+        return i
+    }
+}
+
+function createParamBlock(engine, names) {
+    if (!Array.isArray(names) || names.length === 0) throw new TypeError('names must be a non-empty array')
+    const block = new ParamBlock(new SharedArrayBuffer(names.length * 8), names)
+    engine.attachParamBlock(block.values, block.generations, block.names)
+    return block
+}
+
+module.exports = { ParamBlock, createParamBlock }
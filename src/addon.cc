@@ -1,9 +1,14 @@
 #include <napi.h>
 #include "pd_engine.h"
+#include "pd_mixer.h"
+#include "pd_receiver.h"
 
 Napi::Object InitAll(Napi::Env env, Napi::Object exports)
 {
-    return PdEngine::Init(env, exports);
+    env.SetInstanceData(new PdAddonData());
+    PdEngine::Init(env, exports);
+    PdReceiver::Init(env, exports);
+    return PdMixer::Init(env, exports);
 }
 
 NODE_API_MODULE(NODE_GYP_MODULE_NAME, InitAll)
@@ -1,6 +1,14 @@
 #include "pd_engine.h"
+#include "denormals.h"
+#include "pd_batch.h"
+#include "pd_receiver.h"
+#include "rt_alloc_guard.h"
+#include "simd_gain.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstring>
+#include <cerrno>
 
 #ifdef HAVE_MINIAUDIO
 #define MINIAUDIO_IMPLEMENTATION
@@ -14,6 +22,11 @@ extern "C"
 }
 #endif
 
+#ifdef HAVE_LIBPD
+// Engines sharing the main instance (libpd built without PDINSTANCE)
+static std::atomic<int> s_mainInstanceUsers{0};
+#endif
+
 Napi::Object PdEngine::Init(Napi::Env env, Napi::Object exports)
 {
     Napi::Function func = DefineClass(env, "PdEngine",
@@ -21,19 +34,76 @@ Napi::Object PdEngine::Init(Napi::Env env, Napi::Object exports)
                                        PdEngine::InstanceMethod("stop", &PdEngine::stop),
                                        PdEngine::InstanceMethod("openPatch", &PdEngine::openPatch),
                                        PdEngine::InstanceMethod("closePatch", &PdEngine::closePatch),
+                                       PdEngine::InstanceMethod("openPatchAsync", &PdEngine::openPatchAsync),
+                                       PdEngine::InstanceMethod("closePatchAsync", &PdEngine::closePatchAsync),
+                                       PdEngine::InstanceMethod("reloadPatch", &PdEngine::reloadPatch),
                                        PdEngine::InstanceMethod("sendBang", &PdEngine::sendBang),
                                        PdEngine::InstanceMethod("sendFloat", &PdEngine::sendFloat),
-                                       PdEngine::InstanceMethod("sendSymbol", &PdEngine::sendSymbol)});
+                                       PdEngine::InstanceMethod("sendSymbol", &PdEngine::sendSymbol),
+                                       PdEngine::InstanceMethod("sendList", &PdEngine::sendList),
+                                       PdEngine::InstanceMethod("sendBangAt", &PdEngine::sendBangAt),
+                                       PdEngine::InstanceMethod("sendFloatAt", &PdEngine::sendFloatAt),
+                                       PdEngine::InstanceMethod("sendSymbolAt", &PdEngine::sendSymbolAt),
+                                       PdEngine::InstanceMethod("sendListAt", &PdEngine::sendListAt),
+                                       PdEngine::InstanceMethod("sendBatch", &PdEngine::sendBatch),
+                                       PdEngine::InstanceMethod("sendNoteOn", &PdEngine::sendNoteOn),
+                                       PdEngine::InstanceMethod("sendCC", &PdEngine::sendCC),
+                                       PdEngine::InstanceMethod("sendProgramChange", &PdEngine::sendProgramChange),
+                                       PdEngine::InstanceMethod("sendPitchBend", &PdEngine::sendPitchBend),
+                                       PdEngine::InstanceMethod("sendAftertouch", &PdEngine::sendAftertouch),
+                                       PdEngine::InstanceMethod("sendPolyAftertouch", &PdEngine::sendPolyAftertouch),
+                                       PdEngine::InstanceMethod("sendMidiBytes", &PdEngine::sendMidiBytes),
+                                       PdEngine::InstanceMethod("sendMidiBatch", &PdEngine::sendMidiBatch),
+                                       PdEngine::InstanceMethod("receiver", &PdEngine::receiver),
+                                       PdEngine::InstanceMethod("attachParamBlock", &PdEngine::attachParamBlock),
+                                       PdEngine::InstanceMethod("arraySize", &PdEngine::arraySize),
+                                       PdEngine::InstanceMethod("readArray", &PdEngine::readArray),
+                                       PdEngine::InstanceMethod("writeArray", &PdEngine::writeArray),
+                                       PdEngine::InstanceMethod("resizeArray", &PdEngine::resizeArray),
+                                       PdEngine::InstanceMethod("loadArray", &PdEngine::loadArray),
+                                       PdEngine::InstanceMethod("getSampleTime", &PdEngine::getSampleTime),
+                                       PdEngine::InstanceMethod("getLatency", &PdEngine::getLatency),
+                                       PdEngine::InstanceMethod("getStats", &PdEngine::getStats),
+                                       PdEngine::InstanceMethod("getMeters", &PdEngine::getMeters),
+                                       PdEngine::InstanceMethod("attachMeterBuffer", &PdEngine::attachMeterBuffer),
+                                       PdEngine::InstanceMethod("setGain", &PdEngine::setGain),
+                                       PdEngine::InstanceMethod("setClip", &PdEngine::setClip),
+                                       PdEngine::InstanceMethod("setRenderAhead", &PdEngine::setRenderAhead),
+                                       PdEngine::InstanceMethod("getRenderWatermark", &PdEngine::getRenderWatermark),
+                                       PdEngine::InstanceMethod("getRealtimeStatus", &PdEngine::getRealtimeStatus),
+                                       PdEngine::InstanceMethod("render", &PdEngine::render),
+                                       PdEngine::InstanceMethod("renderAsync", &PdEngine::renderAsync),
+                                       PdEngine::InstanceMethod("on", &PdEngine::on),
+                                       PdEngine::InstanceMethod("off", &PdEngine::off),
+                                       PdEngine::InstanceMethod("onMidi", &PdEngine::onMidi),
+                                       PdEngine::InstanceMethod("offMidi", &PdEngine::offMidi),
+                                       PdEngine::InstanceMethod("onPrint", &PdEngine::onPrint),
+                                       PdEngine::InstanceMethod("offPrint", &PdEngine::offPrint),
+                                       PdEngine::InstanceMethod("tap", &PdEngine::tap),
+                                       PdEngine::InstanceMethod("untap", &PdEngine::untap)});
 
+    env.GetInstanceData<PdAddonData>()->engine = Napi::Persistent(func);
     exports.Set("PdEngine", func);
     return exports;
 }
 
+bool PdEngine::IsInstance(Napi::Env env, Napi::Value value)
+{
+    if (!value.IsObject())
+        return false;
+    return value.As<Napi::Object>().InstanceOf(env.GetInstanceData<PdAddonData>()->engine.Value());
+}
+
 PdEngine::PdEngine(const Napi::CallbackInfo &info)
     : Napi::ObjectWrap<PdEngine>(info)
 {
-    // TODO: Wire libpd init here when available
-    // Options: { sampleRate?: number, blockSize?: number, channelsOut?: number, channelsIn?: number }
+    // Options: { sampleRate?: number, blockSize?: number, channelsOut?: number, channelsIn?: number,
+    //           commandQueueSize?: number, messageQueueSize?: number, scheduleQueueSize?: number,
+    //           midiQueueSize?: number, printQueueSize?: number, printRate?: number,
+    //           gain?: number, clip?: boolean, metering?: boolean, truePeak?: boolean, meterWindowMs?: number,
+    //           renderThread?: boolean, renderAhead?: number,
+    //           schedPolicy?: 'fifo' | 'rr', schedPriority?: number, lockMemory?: boolean, cpuAffinity?: number[],
+    //           denormalProtection?: boolean }
     if (info.Length() > 0 && info[0].IsObject())
     {
         auto obj = info[0].As<Napi::Object>();
@@ -45,11 +115,69 @@ PdEngine::PdEngine(const Napi::CallbackInfo &info)
             channelsOut_ = obj.Get("channelsOut").As<Napi::Number>().Int32Value();
         if (obj.Has("channelsIn"))
             channelsIn_ = obj.Get("channelsIn").As<Napi::Number>().Int32Value();
+        if (obj.Has("commandQueueSize"))
+            commandQueueSize_ = obj.Get("commandQueueSize").As<Napi::Number>().Int32Value();
+        if (obj.Has("messageQueueSize"))
+            messageQueueSize_ = obj.Get("messageQueueSize").As<Napi::Number>().Int32Value();
+        if (obj.Has("scheduleQueueSize"))
+            scheduleQueueSize_ = obj.Get("scheduleQueueSize").As<Napi::Number>().Int32Value();
+        if (obj.Has("midiQueueSize"))
+            midiQueueSize_ = obj.Get("midiQueueSize").As<Napi::Number>().Int32Value();
+        if (obj.Has("printQueueSize"))
+            printQueueSize_ = obj.Get("printQueueSize").As<Napi::Number>().Int32Value();
+        if (obj.Has("printRate"))
+            printRate_ = obj.Get("printRate").As<Napi::Number>().Int32Value();
+        if (obj.Has("gain"))
+            targetGain_.store(obj.Get("gain").As<Napi::Number>().FloatValue());
+        if (obj.Has("clip"))
+            clip_.store(obj.Get("clip").ToBoolean().Value());
+        if (obj.Has("metering"))
+            metering_ = obj.Get("metering").ToBoolean().Value();
+        if (obj.Has("truePeak"))
+            truePeak_ = obj.Get("truePeak").ToBoolean().Value();
+        if (obj.Has("meterWindowMs"))
+            meterWindowMs_ = obj.Get("meterWindowMs").As<Napi::Number>().Int32Value();
+        if (obj.Has("renderThread"))
+            renderThread_ = obj.Get("renderThread").ToBoolean().Value();
+        if (obj.Has("renderAhead"))
+            renderAhead_ = obj.Get("renderAhead").As<Napi::Number>().Int32Value();
+        ParseRtThreadOptions(obj, rtOptions_);
+        if (obj.Has("denormalProtection"))
+            denormalProtection_ = obj.Get("denormalProtection").ToBoolean().Value();
+        if (obj.Has("lockMemory"))
+            lockMemory_ = obj.Get("lockMemory").ToBoolean().Value();
     }
+    if (commandQueueSize_ < 1)
+        commandQueueSize_ = 1;
+    if (messageQueueSize_ < 1)
+        messageQueueSize_ = 1;
+    if (scheduleQueueSize_ < 1)
+        scheduleQueueSize_ = 1;
+    if (midiQueueSize_ < 1)
+        midiQueueSize_ = 1;
+    // Au moins une ligne complète avec son en-tête
+    if (printQueueSize_ < (int)kPrintLineMax + 8)
+        printQueueSize_ = (int)kPrintLineMax + 8;
+    if (printRate_ < 0)
+        printRate_ = 0;
+    commands_.Allocate((size_t)commandQueueSize_);
+    messages_.Allocate((size_t)messageQueueSize_);
+    scheduled_.Allocate((size_t)scheduleQueueSize_);
+    midiOut_.Allocate((size_t)midiQueueSize_);
+    printRing_.Allocate((size_t)printQueueSize_);
+    printOut_.Allocate((size_t)printQueueSize_);
+    if (meterWindowMs_ < 1)
+        meterWindowMs_ = 1;
+    meter_.Configure((uint32_t)(channelsOut_ > 0 ? channelsOut_ : 1),
+                     (uint32_t)((int64_t)sampleRate_ * meterWindowMs_ / 1000), truePeak_);
+    fadeScratch_.Allocate((size_t)kPdBlockSize * (size_t)(channelsOut_ > 0 ? channelsOut_ : 1));
 
-#ifdef HAVE_LIBPD
-    // Defer full init until start() when audio is set up
-#endif
+    // libpd doit exister avant le premier on() (libpd_bind) ; l'audio attend start()
+    if (!InitPd())
+    {
+        Napi::Error::New(info.Env(), "libpd was built without PDINSTANCE: only one PdEngine can exist at a time")
+            .ThrowAsJavaScriptException();
+    }
 }
 
 PdEngine::~PdEngine()
@@ -58,117 +186,196 @@ PdEngine::~PdEngine()
     {
         StopInternal();
     }
+    CloseTap();
+    // Plus de thread audio : on libère les bindings directement
+    SelectInstance();
+    for (auto &entry : listeners_)
+    {
+        PdCommand cmd{};
+        cmd.type = PdCommandType::Unbind;
+        cmd.ptr = &entry.second->binding;
+        DispatchCommand(cmd);
+    }
+    StopPrintDrain();
+    StopNotifier();
+#ifdef HAVE_LIBPD
+    if (patch_)
+    {
+        libpd_closefile(patch_);
+        patch_ = nullptr;
+    }
+    if (ownsMainInstance_)
+        s_mainInstanceUsers.fetch_sub(1, std::memory_order_relaxed);
+    else if (instance_)
+        libpd_free_instance(instance_);
+    instance_ = nullptr;
+#endif
 }
 
-Napi::Value PdEngine::start(const Napi::CallbackInfo &info)
+// Creates this engine's Pd instance and installs the hooks on it. Returns false
+// when libpd has no multi-instance support and the main instance is taken.
+bool PdEngine::InitPd()
 {
-    Napi::Env env = info.Env();
-    if (running_)
-        return env.Undefined();
-
 #ifdef HAVE_LIBPD
-    libpd_init();
-    libpd_init_audio(channelsIn_, channelsOut_, sampleRate_);
-
-    // Calculer le nombre de ticks (1 tick = 64 samples dans PureData)
-    int numTicks = blockSize_ / 64;
-    if (numTicks < 1)
-        numTicks = 1; // Au moins 1 tick
+    libpd_init(); // idempotent: sets up the main instance once per process
+    instance_ = libpd_new_instance();
+    if (!instance_)
+    {
+        // libpd sans PDINSTANCE : une seule instance pour tout le processus
+        if (s_mainInstanceUsers.fetch_add(1, std::memory_order_relaxed) > 0)
+        {
+            s_mainInstanceUsers.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        ownsMainInstance_ = true;
+        instance_ = libpd_main_instance();
+    }
+    SelectInstance();
+    // Les hooks n'ont pas de paramètre utilisateur : ils retrouvent le PdEngine
+    // via les données d'instance libpd
+    libpd_set_instancedata(this, nullptr);
+    InstallHooks();
+#endif
+    return true;
+}
 
-    // Ajuster blockSize_ pour qu'il soit un multiple de 64
-    blockSize_ = numTicks * 64;
+// Hooks of the selected instance. Until it has instance data (a spare instance
+// being prepared by reloadPatch), they drop everything.
+void PdEngine::InstallHooks()
+{
+#ifdef HAVE_LIBPD
+    libpd_set_banghook(&PdEngine::PdBangHook);
+    libpd_set_floathook(&PdEngine::PdFloatHook);
+    libpd_set_symbolhook(&PdEngine::PdSymbolHook);
+    libpd_set_listhook(&PdEngine::PdListHook);
+    libpd_set_messagehook(&PdEngine::PdMessageHook);
+    libpd_set_printhook(&PdEngine::PdPrintHook);
+    libpd_set_noteonhook(&PdEngine::PdNoteOnHook);
+    libpd_set_controlchangehook(&PdEngine::PdControlChangeHook);
+    libpd_set_programchangehook(&PdEngine::PdProgramChangeHook);
+    libpd_set_pitchbendhook(&PdEngine::PdPitchBendHook);
+    libpd_set_aftertouchhook(&PdEngine::PdAftertouchHook);
+    libpd_set_polyaftertouchhook(&PdEngine::PdPolyAftertouchHook);
+    libpd_set_midibytehook(&PdEngine::PdMidiByteHook);
+#endif
+}
 
-    // Configurer la taille de bloc via les messages appropriés
-    // Note: le paramètre "ticks" est souvent utilisé dans libpd pour le traitement audio
-    // Pour PureData natif, on peut utiliser "-blocksize" à la place
+// libpd's current instance is per thread (PDTHREADS): select ours before any call
+void PdEngine::SelectInstance() const
+{
+#ifdef HAVE_LIBPD
+    libpd_set_instance(instance_);
+#endif
+}
 
-    // Activer le traitement audio
-    libpd_start_message(1);
-    libpd_add_float(1.0f);
-    libpd_finish_message("pd", "dsp");
+Napi::Value PdEngine::start(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (running_)
+        return env.Undefined();
+    if (renderThread_ && channelsIn_ > 0)
+    {
+        // On ne peut pas rendre en avance une entrée qui n'est pas encore arrivée
+        Napi::Error::New(env, "renderThread mode does not support audio input").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
 
-    printf("Pure Data initialized with: blockSize=%d samples (buffer %d ms), sampleRate=%d, channels in/out=%d/%d\n",
-           blockSize_, (blockSize_ * 1000) / sampleRate_, sampleRate_, channelsIn_, channelsOut_);
-#endif
+    if (offlineBusy_ || mixerAttached_)
+    {
+        Napi::Error::New(env, offlineBusy_ ? "offline render in progress" : "engine is attached to a PdMixer")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
 
+    StartDsp();
+    // Le device reprend les buffers : un render() suivant repartira de zéro
+    offlineReady_ = false;
 #ifdef HAVE_MINIAUDIO
-    // Set up static variables for the callback
-    static ma_uint32 s_channels = (ma_uint32)channelsOut_;
-    static ma_uint32 s_sampleRate = (ma_uint32)sampleRate_;
+    // Tout ce dont le callback a besoin est alloué ici, jamais dans le thread audio
+    AllocateBuffers();
 
-    ma_device_config config = ma_device_config_init(ma_device_type_playback);
+    // mlockall avant de démarrer les threads : leurs piles sont verrouillées aussi
+    if (lockMemory_ && memoryLockStatus_ != 0)
+        memoryLockStatus_ = LockProcessMemory();
+    for (RtThreadStatus *status : {&audioThreadStatus_, &renderThreadStatus_})
+    {
+        status->applied.store(false, std::memory_order_relaxed);
+        status->sched.store(kRtNotRequested, std::memory_order_relaxed);
+        status->affinity.store(kRtNotRequested, std::memory_order_relaxed);
+    }
+    rtSetupPending_ = true;
+
+    // Avec des entrées, un device duplex : chaque callback lit la capture une fois
+    // et écrit la sortie une fois, sur la même période
+    ma_device_config config = ma_device_config_init(channelsIn_ > 0 ? ma_device_type_duplex : ma_device_type_playback);
+    if (channelsIn_ > 0)
+    {
+        config.capture.format = ma_format_f32;
+        config.capture.channels = (ma_uint32)channelsIn_;
+    }
     config.playback.format = ma_format_f32;
-    config.playback.channels = s_channels;
-    config.sampleRate = s_sampleRate;
+    config.playback.channels = (ma_uint32)channelsOut_;
+    config.sampleRate = (ma_uint32)sampleRate_;
     config.periodSizeInFrames = blockSize_; // Configurer la taille du buffer audio
+    config.noFixedSizedCallback = MA_TRUE;  // Période native du backend, la TickFifo s'adapte
     config.pUserData = this;                // Passer l'instance PdEngine au callback
 
     config.dataCallback = [](ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount)
     {
-        (void)pDevice;
-        (void)pInput;
-        float *out = (float *)pOutput;
-#ifdef HAVE_LIBPD
-        // Taille fixe d'un bloc PureData = 64 échantillons (standard dans PD)
-        const int pdBlockSize = 64;
-
-        // Allouer un buffer pour les résultats
-        // frameCount = nombre d'échantillons demandés par miniaudio
-        std::vector<float> outBuf(frameCount * (size_t)s_channels, 0.0f);
-
-        // Calculer le nombre de "ticks" PureData à traiter
-        // Un tick = 64 samples dans PureData
-        int ticks = frameCount / pdBlockSize;
-        if (ticks < 1)
-            ticks = 1;
-
-        // Traiter l'audio avec libpd exactement comme dans l'exemple pdtest.c
-        // Premier paramètre = nombre de ticks à traiter
-        // Deuxième paramètre = buffer d'entrée (nullptr car pas d'entrée)
-        // Troisième paramètre = buffer de sortie
-        if (libpd_process_float(ticks, nullptr, outBuf.data()) != 0)
-        {
-            // En cas d'erreur, produire un son silencieux
-            memset(out, 0, frameCount * s_channels * sizeof(float));
-            return;
-        }
-
-        // Appliquer un gain pour éviter la saturation
-        const float gain = 0.8f;
-        for (ma_uint32 i = 0; i < frameCount * s_channels; ++i)
+        auto *self = static_cast<PdEngine *>(pDevice->pUserData);
+        // Un thread de device par moteur, mais on ne suppose rien du backend
+        self->SelectInstance();
+        if (self->rtSetupPending_)
         {
-            out[i] = outBuf[i] * gain;
+            // Premier callback : priorité et affinité du thread audio, une seule fois
+            self->rtSetupPending_ = false;
+            ApplyRtThreadOptions(self->rtOptions_, self->audioThreadStatus_);
         }
-#else
-        static double phase = 0.0;
-        double freq = 440.0;
-        double sr = (double)s_sampleRate;
-        for (ma_uint32 i = 0; i < frameCount; ++i)
+        self->dspMeter_.Begin();
         {
-            float s = (float)std::sin(2.0 * M_PI * phase);
-            for (ma_uint32 ch = 0; ch < s_channels; ++ch)
-            {
-                out[i * s_channels + ch] = s * 0.1f;
-            }
-            phase += freq / sr;
-            if (phase >= 1.0)
-                phase -= 1.0;
+            // FTZ/DAZ pendant le callback seulement : l'état FPU du thread de miniaudio
+            // est restauré à chaque sortie, donc aussi après stop()
+            ScopedDenormalGuard denormals(self->denormalProtection_);
+            if (self->renderThread_)
+                self->PlayRendered(static_cast<float *>(pOutput), frameCount);
+            else
+                self->AudioCallback(static_cast<float *>(pOutput), static_cast<const float *>(pInput), frameCount);
         }
-#endif
+        self->dspMeter_.End(frameCount, self->sampleRate_, self->processErrors_.load(std::memory_order_relaxed));
+        self->dspStats_.Store(self->dspMeter_.Stats());
     };
-    static ma_device g_device; // static storage for device
-    if (ma_device_init(nullptr, &config, &g_device) != MA_SUCCESS)
+    if (!deviceStorage_)
+        deviceStorage_.reset(new ma_device());
+    if (ma_device_init(nullptr, &config, deviceStorage_.get()) != MA_SUCCESS)
     {
         Napi::Error::New(env, "Failed to init audio device").ThrowAsJavaScriptException();
         return env.Undefined();
     }
-    if (ma_device_start(&g_device) != MA_SUCCESS)
+    if (renderThread_)
+    {
+        // blockSize n'est qu'une demande (noFixedSizedCallback) : l'avance se compte
+        // en périodes que le backend livre vraiment
+        const uint32_t internal = deviceStorage_->playback.internalPeriodSizeInFrames;
+        AllocateRenderAhead(internal > (uint32_t)blockSize_ ? internal : (uint32_t)blockSize_);
+    }
+
+    // Dès ici libpd appartient au thread DSP : les commandes JS passent par la file
+    dspActive_ = true;
+    if (renderThread_)
+    {
+        // Le thread de rendu remplit l'avance avant le premier callback
+        renderStop_.store(false, std::memory_order_relaxed);
+        renderWorker_ = std::thread(&PdEngine::RenderThreadMain, this);
+    }
+    if (ma_device_start(deviceStorage_.get()) != MA_SUCCESS)
     {
-        ma_device_uninit(&g_device);
+        ma_device_uninit(deviceStorage_.get());
+        StopRenderThread();
+        dspActive_ = false;
         Napi::Error::New(env, "Failed to start audio device").ThrowAsJavaScriptException();
         return env.Undefined();
     }
-    device_ = &g_device;
+    device_ = deviceStorage_.get();
 #endif
     running_ = true;
     return env.Undefined();
@@ -194,100 +401,3663 @@ void PdEngine::StopInternal()
         device_ = nullptr;
     }
 #endif
+    StopRenderThread();
+    dspActive_ = false;
+    // Le thread audio est arrêté : on reprend le rôle de consommateur pour ne pas
+    // perdre les messages encore en file
+    ReclaimDsp();
     running_ = false;
 }
 
-Napi::Value PdEngine::openPatch(const Napi::CallbackInfo &info)
+// JS thread, once no DSP thread renders anymore: finishes what it left pending
+void PdEngine::ReclaimDsp()
+{
+    SelectInstance();
+    RunRequest(false);
+    EndCrossfade();
+    DrainCommands();
+}
+
+// libpd audio setup shared by start() and offline rendering
+void PdEngine::StartDsp()
+{
+    // blockSize n'est qu'une indication de période pour le backend : elle n'a plus
+    // besoin d'être un multiple de 64, la TickFifo fait le lien avec les ticks Pd
+    if (blockSize_ < 1)
+        blockSize_ = (int)kPdBlockSize;
+    SelectInstance();
+    InitInstanceAudio();
+}
+
+// Audio setup of the selected instance (also run on reloadPatch's spare)
+void PdEngine::InitInstanceAudio()
 {
-    Napi::Env env = info.Env();
-    if (info.Length() < 1 || !info[0].IsString())
-    {
-        Napi::TypeError::New(env, "path string required").ThrowAsJavaScriptException();
-        return env.Null();
-    }
-    std::string path = info[0].As<Napi::String>().Utf8Value();
 #ifdef HAVE_LIBPD
-    std::string dir, name;
-    splitPath(path, dir, name);
-    patch_ = libpd_openfile(name.c_str(), dir.c_str());
-    if (!patch_)
+    libpd_init_audio(channelsIn_, channelsOut_, sampleRate_);
+
+    // Activer le traitement audio
+    libpd_start_message(1);
+    libpd_add_float(1.0f);
+    libpd_finish_message("pd", "dsp");
+#endif
+}
+
+void PdEngine::AllocateBuffers()
+{
+    // Un tick entier de scratch, et de quoi garder les 63 frames au plus qui
+    // dépassent de la période courante
+    tickScratch_.Allocate((size_t)kPdBlockSize * (size_t)channelsOut_);
+    tickFifo_.Allocate((uint32_t)channelsOut_, kPdBlockSize);
+    if (channelsIn_ > 0)
     {
-        Napi::Error::New(env, "Failed to open patch").ThrowAsJavaScriptException();
+        // Côté entrée : un tick de scratch et quatre ticks de marge pour l'entrée
+        // pas encore consommée quand la période n'est pas multiple de 64
+        inScratch_.Allocate((size_t)kPdBlockSize * (size_t)channelsIn_);
+        inFifo_.Allocate((uint32_t)channelsIn_, 4 * kPdBlockSize);
     }
-#else
-    // Pour les tests sans libpd, on affiche simplement le chemin
-    printf("Opened patch at startup: %s\n", path.c_str());
-    // Ne rien faire avec path pour éviter les avertissements
-#endif
-    return env.Undefined();
+    periodIn_ = nullptr;
+    periodInFrames_ = 0;
+    periodInPos_ = 0;
+    currentGain_ = targetGain_.load(std::memory_order_relaxed);
+    lastPeriodFrames_.store(0, std::memory_order_relaxed);
+    fifoFrames_.store(0, std::memory_order_relaxed);
+    // Les statistiques DSP repartent de zéro à chaque start()
+    processErrors_.store(0, std::memory_order_relaxed);
+    dspMeter_.Reset();
+    dspStats_.Store(dspMeter_.Stats());
 }
 
-Napi::Value PdEngine::closePatch(const Napi::CallbackInfo &info)
+// Runs on the miniaudio thread: no allocation, no locks, no N-API.
+// `in` is the capture buffer in duplex mode (channelsIn_ > 0), nullptr otherwise.
+void PdEngine::AudioCallback(float *out, const float *in, uint32_t frameCount)
 {
-    Napi::Env env = info.Env();
+    RtAllocScope rtScope;
+    const uint32_t channels = (uint32_t)channelsOut_;
 #ifdef HAVE_LIBPD
-    if (patch_)
+    float *dst = out;
+    uint32_t remaining = frameCount;
+    bool ok = true;
+
+    periodIn_ = in;
+    periodInFrames_ = in ? frameCount : 0;
+    periodInPos_ = 0;
+
+    // 1. Les frames restantes du tick rendu lors de la période précédente
+    uint32_t served = tickFifo_.Read(dst, remaining);
+    dst += (size_t)served * channels;
+    remaining -= served;
+
+    // 2. Les ticks entiers sont rendus directement dans le buffer du device
+    while (remaining >= kPdBlockSize)
     {
-        libpd_closefile(patch_);
-        patch_ = nullptr;
+        if (RenderTick(TickInput(), dst) != 0)
+            ok = false;
+        dst += (size_t)kPdBlockSize * channels;
+        remaining -= kPdBlockSize;
+    }
+
+    // 3. Un tick de plus pour la fin de la période, le surplus part dans la FIFO
+    if (remaining > 0)
+    {
+        float *tick = tickScratch_.Data();
+        if (RenderTick(TickInput(), tick) != 0)
+            ok = false;
+        memcpy(dst, tick, (size_t)remaining * channels * sizeof(float));
+        tickFifo_.Write(tick + (size_t)remaining * channels, kPdBlockSize - remaining);
+    }
+
+    // L'entrée non consommée par cette période sera lue au prochain tick
+    if (periodIn_ && periodInPos_ < periodInFrames_)
+        inFifo_.Write(periodIn_ + (size_t)periodInPos_ * channelsIn_, periodInFrames_ - periodInPos_);
+    periodIn_ = nullptr;
+
+    ChannelLevels levels{};
+    if (!ok)
+    {
+        // En cas d'erreur, produire un son silencieux
+        memset(out, 0, (size_t)frameCount * channels * sizeof(float));
+    }
+    else
+    {
+        // Gain maître (rampe sur la période pour éviter le zipper noise) et clip
+        // optionnel, en une seule passe SIMD sur le buffer du device, qui mesure
+        // aussi les niveaux au passage
+        const float gain = targetGain_.load(std::memory_order_relaxed);
+        const bool clip = clip_.load(std::memory_order_relaxed);
+        if (metering_)
+            ApplyGainMetered(out, out, (size_t)frameCount * channels, currentGain_, gain, clip, channels, levels);
+        else
+            ApplyGain(out, out, (size_t)frameCount * channels, currentGain_, gain, clip, channels);
+        currentGain_ = gain;
+    }
+    if (metering_)
+        meter_.Add(out, frameCount, levels);
+
+    lastPeriodFrames_.store(frameCount, std::memory_order_relaxed);
+    fifoFrames_.store(tickFifo_.Frames(), std::memory_order_relaxed);
+#else
+    (void)in;
+    const double freq = 440.0;
+    const double sr = (double)sampleRate_;
+    for (uint32_t i = 0; i < frameCount; ++i)
+    {
+        float s = (float)std::sin(2.0 * M_PI * phase_);
+        for (uint32_t ch = 0; ch < channels; ++ch)
+        {
+            out[i * channels + ch] = s * 0.1f;
+        }
+        phase_ += freq / sr;
+        if (phase_ >= 1.0)
+            phase_ -= 1.0;
     }
 #endif
-    return env.Undefined();
+    TapOutput(out, frameCount);
 }
 
-Napi::Value PdEngine::sendBang(const Napi::CallbackInfo &info)
+// Entrée du prochain tick (64 frames de channelsIn_ canaux), ou nullptr sans capture.
+// Quand rien n'attend dans inFifo_ et que la période contient un tick entier, le
+// buffer de capture de miniaudio est passé tel quel à libpd, sans copie : c'est
+// toujours le cas lorsque la période est un multiple de 64.
+const float *PdEngine::TickInput()
 {
-    Napi::Env env = info.Env();
-    if (info.Length() < 1 || !info[0].IsString())
+    if (channelsIn_ <= 0)
+        return nullptr;
+    const uint32_t chIn = (uint32_t)channelsIn_;
+    float *buf = inScratch_.Data();
+    if (!periodIn_)
     {
-        Napi::TypeError::New(env, "receiver name string required").ThrowAsJavaScriptException();
-        return env.Null();
+        memset(buf, 0, (size_t)kPdBlockSize * chIn * sizeof(float));
+        return buf;
     }
-    std::string recv = info[0].As<Napi::String>().Utf8Value();
+    if (inFifo_.Frames() == 0 && periodInPos_ + kPdBlockSize <= periodInFrames_)
+    {
+        const float *tickIn = periodIn_ + (size_t)periodInPos_ * chIn;
+        periodInPos_ += kPdBlockSize;
+        return tickIn;
+    }
+
+    // Sinon on complète la FIFO avec juste ce qu'il faut de la période courante
+    if (inFifo_.Frames() < kPdBlockSize)
+    {
+        uint32_t want = kPdBlockSize - inFifo_.Frames();
+        uint32_t avail = periodInFrames_ - periodInPos_;
+        uint32_t n = want < avail ? want : avail;
+        inFifo_.Write(periodIn_ + (size_t)periodInPos_ * chIn, n);
+        periodInPos_ += n;
+    }
+    uint32_t got = inFifo_.Read(buf, kPdBlockSize);
+    if (got < kPdBlockSize)
+    {
+        // Le tick partiel est rendu avant que son entrée n'arrive : on complète par
+        // du silence. Cela n'arrive qu'au démarrage, le temps que le retard
+        // d'entrée se cale sur le reste de la TickFifo (< 64 frames)
+        memset(buf + (size_t)got * chIn, 0, (size_t)(kPdBlockSize - got) * chIn * sizeof(float));
+    }
+    return buf;
+}
+
+// Rend un tick Pd dans out, après avoir vidé la file de commandes et envoyé les
+// messages datés qui tombent dans ce tick
+int PdEngine::RenderTick(const float *in, float *out)
+{
+    int err = 0;
+    RunRequest(true);
+    DrainCommands();
+    ScanParamBlocks();
+    DispatchScheduled();
 #ifdef HAVE_LIBPD
-    libpd_bang(recv.c_str());
+    err = libpd_process_float(1, in, out);
+    if (err != 0)
+        processErrors_.fetch_add(1, std::memory_order_relaxed);
+    else if (fadeInstance_)
+        CrossfadeTick(in, out);
 #else
-    (void)recv;
+    (void)in;
+    (void)out;
 #endif
-    return env.Undefined();
+    sampleTime_ += kPdBlockSize;
+    sampleClock_.store(sampleTime_, std::memory_order_relaxed);
+    return err;
 }
 
-Napi::Value PdEngine::sendFloat(const Napi::CallbackInfo &info)
+// Render-ahead mode: this thread owns libpd and keeps renderRing_ filled up to
+// renderTargetFrames_; the device callback (PlayRendered) only copies out.
+void PdEngine::RenderThreadMain()
 {
-    Napi::Env env = info.Env();
-    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsNumber())
+    SelectInstance();
+    ApplyRtThreadOptions(rtOptions_, renderThreadStatus_);
+    ScopedDenormalGuard denormals(denormalProtection_);
+    float *tick = tickScratch_.Data();
+    const size_t tickBytes = (size_t)kPdBlockSize * (size_t)channelsOut_ * sizeof(float);
+    while (!renderStop_.load(std::memory_order_acquire))
     {
-        Napi::TypeError::New(env, "(receiver: string, value: number)").ThrowAsJavaScriptException();
-        return env.Null();
+        {
+            RtAllocScope rtScope;
+            const uint32_t target = renderTargetFrames_.load(std::memory_order_relaxed);
+            uint32_t fill = renderRing_.CapacityFrames() - renderRing_.WritableFrames();
+            while (fill < target && renderRing_.WritableFrames() >= kPdBlockSize)
+            {
+                if (RenderTick(nullptr, tick) != 0)
+                    memset(tick, 0, tickBytes);
+                renderRing_.Write(tick, kPdBlockSize);
+                fill += kPdBlockSize;
+            }
+        }
+        // Réveillé par le callback après chaque lecture ; le délai ne sert qu'à
+        // revoir renderStop_ et une cible modifiée entre deux périodes
+        renderSem_.WaitFor(50);
     }
-    std::string recv = info[0].As<Napi::String>().Utf8Value();
-    double value = info[1].As<Napi::Number>().DoubleValue();
-#ifdef HAVE_LIBPD
-    libpd_float(recv.c_str(), (float)value);
-#else
-    (void)recv;
-    (void)value;
-#endif
-    return env.Undefined();
 }
 
-Napi::Value PdEngine::sendSymbol(const Napi::CallbackInfo &info)
+void PdEngine::StopRenderThread()
 {
-    Napi::Env env = info.Env();
-    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString())
+    if (!renderWorker_.joinable())
+        return;
+    renderStop_.store(true, std::memory_order_release);
+    renderSem_.Post();
+    renderWorker_.join();
+}
+
+// JS thread, device initialized but not started: sizes the ring for the deepest
+// render-ahead at the period the backend actually delivers
+void PdEngine::AllocateRenderAhead(uint32_t periodFrames)
+{
+    renderPeriodFrames_ = periodFrames > kPdBlockSize ? periodFrames : kPdBlockSize;
+    renderRing_.Allocate((uint32_t)channelsOut_, kMaxRenderAhead * renderPeriodFrames_ + kPdBlockSize);
+    SetRenderAheadPeriods(renderAhead_);
+    renderLowWater_.store(UINT32_MAX, std::memory_order_relaxed);
+}
+
+void PdEngine::SetRenderAheadPeriods(int periods)
+{
+    if (periods < 1)
+        periods = 1;
+    if (periods > kMaxRenderAhead)
+        periods = kMaxRenderAhead;
+    renderAhead_ = periods;
+    // Une période est au moins celle du device et la dernière vue dans le callback
+    uint32_t period = renderPeriodFrames_ > (uint32_t)blockSize_ ? renderPeriodFrames_ : (uint32_t)blockSize_;
+    const uint32_t observed = lastPeriodFrames_.load(std::memory_order_relaxed);
+    if (observed > period)
+        period = observed;
+    // Arrondi au tick supérieur : le thread de rendu avance par ticks entiers
+    uint32_t frames = (uint32_t)periods * period;
+    frames = (frames + kPdBlockSize - 1) / kPdBlockSize * kPdBlockSize;
+    const uint32_t capacity = renderRing_.CapacityFrames() / kPdBlockSize * kPdBlockSize;
+    if (capacity > 0 && frames > capacity)
+        frames = capacity;
+    renderTargetFrames_.store(frames, std::memory_order_relaxed);
+    renderSem_.Post();
+}
+
+// Device callback in render-ahead mode: copy out of the ring (fused with the
+// gain stage), never render.
+void PdEngine::PlayRendered(float *out, uint32_t frameCount)
+{
+    RtAllocScope rtScope;
+    if (frameCount == 0)
+        return;
+    const uint32_t channels = (uint32_t)channelsOut_;
+    const uint32_t fill = renderRing_.ReadableFrames();
+    uint32_t low = renderLowWater_.load(std::memory_order_relaxed);
+    while (fill < low && !renderLowWater_.compare_exchange_weak(low, fill, std::memory_order_relaxed))
     {
-        Napi::TypeError::New(env, "(receiver: string, symbol: string)").ThrowAsJavaScriptException();
-        return env.Null();
     }
-    std::string recv = info[0].As<Napi::String>().Utf8Value();
-    std::string sym = info[1].As<Napi::String>().Utf8Value();
+
+    const float *first;
+    const float *second;
+    uint32_t firstFrames, secondFrames;
+    const uint32_t got = renderRing_.Peek(frameCount, first, firstFrames, second, secondFrames);
+
+    // La rampe de gain couvre toute la période, à cheval sur les deux segments
+    const float g0 = currentGain_;
+    const float g1 = targetGain_.load(std::memory_order_relaxed);
+    const bool clip = clip_.load(std::memory_order_relaxed);
+    const float gMid = g0 + (g1 - g0) * ((float)firstFrames / (float)frameCount);
+    const float gEnd = g0 + (g1 - g0) * ((float)got / (float)frameCount);
+    ChannelLevels levels{};
+    if (metering_)
+    {
+        ApplyGainMetered(out, first, (size_t)firstFrames * channels, g0, gMid, clip, channels, levels);
+        ApplyGainMetered(out + (size_t)firstFrames * channels, second, (size_t)secondFrames * channels, gMid, gEnd,
+                         clip, channels, levels);
+    }
+    else
+    {
+        ApplyGain(out, first, (size_t)firstFrames * channels, g0, gMid, clip, channels);
+        ApplyGain(out + (size_t)firstFrames * channels, second, (size_t)secondFrames * channels, gMid, gEnd, clip,
+                  channels);
+    }
+    renderRing_.Consume(got);
+    currentGain_ = g1;
+
+    if (got < frameCount)
+    {
+        // Le thread de rendu n'a pas suivi : silence pour le reste de la période
+        memset(out + (size_t)got * channels, 0, (size_t)(frameCount - got) * channels * sizeof(float));
+        renderUnderruns_.fetch_add(1, std::memory_order_relaxed);
+    }
+    renderSem_.Post();
+    if (metering_)
+        meter_.Add(out, frameCount, levels);
+    TapOutput(out, frameCount);
+
+    lastPeriodFrames_.store(frameCount, std::memory_order_relaxed);
+    fifoFrames_.store(fill - got, std::memory_order_relaxed);
+}
+
+// Output tap: the audio side writes whole periods into ring or drops them
+// (overruns); the tap thread cuts the ring into chunks of `frames` frames, each
+// filled into the next Float32Array of a pool and handed to JS through tsfn.
+// freeSem counts the pool entries JS is not holding: with the 'drop' policy a
+// chunk is skipped when none is free, with 'block' the tap thread waits and the
+// ring takes up the slack. The audio thread never waits either way.
+struct PdTap
+{
+    uint32_t frames = 0;
+    uint32_t channels = 0;
+    bool block = false;
+    SpscFrameRing ring;
+    std::vector<Napi::ObjectReference> chunkRefs;
+    std::vector<float *> chunks;
+    uint32_t next = 0; // tap thread
+    RtSemaphore dataSem;
+    RtSemaphore freeSem;
+    std::atomic<bool> wakePending{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> gap{0}; // frames lost since the last chunk handed out
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> overruns{0};
+    std::atomic<uint64_t> skipped{0};
+    std::thread thread;
+    Napi::ThreadSafeFunction tsfn;
+    // JS thread: untap() from inside the callback leaves the delete to it
+    bool delivering = false;
+    bool orphaned = false;
+
+    // Audio side
+    void Write(const float *out, uint32_t channelsOut, uint32_t frameCount)
+    {
+        if (ring.WritableFrames() < frameCount)
+        {
+            // Jamais d'attente ici : la période entière est perdue
+            overruns.fetch_add(frameCount, std::memory_order_relaxed);
+            gap.fetch_add(frameCount, std::memory_order_relaxed);
+        }
+        else
+        {
+            ring.WriteChannels(out, channelsOut, frameCount);
+        }
+        if (ring.ReadableFrames() >= frames && !wakePending.exchange(true, std::memory_order_acq_rel))
+            dataSem.Post();
+    }
+
+    void Run()
+    {
+        while (!stop.load(std::memory_order_acquire))
+        {
+            dataSem.Wait();
+            wakePending.store(false, std::memory_order_release);
+            while (!stop.load(std::memory_order_acquire) && ring.ReadableFrames() >= frames)
+            {
+                if (block)
+                {
+                    freeSem.Wait();
+                    if (stop.load(std::memory_order_acquire))
+                        break;
+                }
+                else if (!freeSem.WaitFor(0))
+                {
+                    ring.Consume(frames);
+                    gap.fetch_add(frames, std::memory_order_relaxed);
+                    skipped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                const uint32_t slot = next;
+                next = (next + 1) % (uint32_t)chunks.size();
+                ring.Read(chunks[slot], frames);
+                const uint64_t lost = gap.exchange(0, std::memory_order_relaxed);
+                // Livrés dans l'ordre : le pool tourne dans le même ordre
+                tsfn.BlockingCall([this, slot, lost](Napi::Env env, Napi::Function callback)
+                                  {
+                    if (env == nullptr)
+                        return;
+                    delivered.fetch_add(1, std::memory_order_relaxed);
+                    delivering = true;
+                    callback.Call({chunkRefs[slot].Value(), Napi::Number::New(env, (double)lost)});
+                    delivering = false;
+                    if (orphaned)
+                        delete this;
+                    else
+                        freeSem.Post(); });
+            }
+        }
+    }
+};
+
+// Audio thread (device callback, render-ahead playback, mixer or offline loop)
+void PdEngine::TapOutput(const float *out, uint32_t frameCount)
+{
+    PdTap *tap = tap_.load();
+    if (!tap)
+        return;
+    // Annonce d'abord, puis vérifie que untap() ne l'a pas retiré entre-temps
+    tapHazard_.store(tap);
+    if (tap_.load() == tap)
+        tap->Write(out, (uint32_t)channelsOut_, frameCount);
+    tapHazard_.store(nullptr, std::memory_order_release);
+}
+
+// JS thread: unpublishes the tap, waits for the audio side to drop it, then stops
+// its thread. Chunks still queued for JS are discarded.
+void PdEngine::CloseTap()
+{
+    PdTap *tap = tap_.exchange(nullptr);
+    if (!tap)
+        return;
+    while (tapHazard_.load() == tap)
+        std::this_thread::yield();
+    tap->stop.store(true, std::memory_order_release);
+    tap->dataSem.Post();
+    tap->freeSem.Post();
+    tap->thread.join();
+    tap->tsfn.Abort();
+    if (tap->delivering)
+        tap->orphaned = true;
+    else
+        delete tap;
+}
+
+bool PdEngine::DspThreadActive() const
+{
+    return dspActive_;
+}
+
+// JS thread. Sans thread audio, libpd n'a pas d'autre utilisateur : appel direct.
+bool PdEngine::PostCommand(const PdCommand &cmd)
+{
+    if (!DspThreadActive())
+    {
+        if (cmd.time != 0)
+        {
+            // Pas de thread DSP : la file datée est à nous jusqu'au prochain start()
+            Schedule(cmd);
+            return true;
+        }
+        SelectInstance();
+        DispatchCommand(cmd);
+        return true;
+    }
+    if (!commands_.TryPush(cmd))
+    {
+        commandOverflows_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+// JS thread, PdReceiver fast path: only the fields the DSP side reads are written
+// into the queue slot, no string is copied
+bool PdEngine::PostHandle(PdCommandType type, PdReceiverHandle *handle, float value, uint64_t time)
+{
+    if (!DspThreadActive())
+    {
+        PdCommand cmd{};
+        cmd.type = type;
+        cmd.value = value;
+        cmd.time = time;
+        cmd.ptr = handle;
+        if (time != 0)
+        {
+            Schedule(cmd);
+            return true;
+        }
+        SelectInstance();
+        DispatchCommand(cmd);
+        return true;
+    }
+    PdCommand *slot = commands_.BeginPush();
+    if (!slot)
+    {
+        commandOverflows_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slot->type = type;
+    slot->value = value;
+    slot->time = time;
+    slot->ptr = handle;
+    commands_.CommitPush();
+    return true;
+}
+
+void PdEngine::DrainCommands()
+{
+    while (const PdCommand *cmd = commands_.Front())
+    {
+        if (cmd->time != 0)
+            Schedule(*cmd);
+        else
+            DispatchCommand(*cmd);
+        commands_.Pop();
+    }
+}
+
+// DSP thread (or the JS thread while no DSP thread runs)
+void PdEngine::Schedule(const PdCommand &cmd)
+{
+    if (!scheduled_.Push(cmd.time, cmd))
+    {
+        scheduledDrops_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    scheduledPending_.store((uint32_t)scheduled_.Size(), std::memory_order_relaxed);
+}
+
 #ifdef HAVE_LIBPD
-    libpd_symbol(recv.c_str(), sym.c_str());
-#else
-    (void)recv;
-    (void)sym;
+// DSP side. Le symbole est résolu au premier envoi, puis seulement après un
+// reloadPatch (nouvelle instance) : sinon ni gensym ni recherche dans la table
+static void SendToHandle(PdReceiverHandle *handle, uint32_t epoch, bool bang, float value)
+{
+    if (!handle->symbol || handle->epoch != epoch)
+    {
+        handle->symbol = gensym(handle->name);
+        handle->epoch = epoch;
+    }
+    t_symbol *sym = static_cast<t_symbol *>(handle->symbol);
+    if (!sym->s_thing)
+        return;
+    sys_lock();
+    if (bang)
+        pd_bang(sym->s_thing);
+    else
+        pd_float(sym->s_thing, value);
+    sys_unlock();
+}
+#endif
+
+// One reloadPatch, owned by its worker. The swap exchanges instance and the
+// bindings' handles with the engine's, so afterwards they hold what the worker
+// must free.
+struct PdReload
+{
+    struct Binding
+    {
+        std::string name;
+        void **slot; // Listener::binding
+        void *handle;
+    };
+    struct _pdinstance *instance = nullptr;
+    void *patch = nullptr;    // opened in the spare instance
+    void *oldPatch = nullptr; // engine's patch when the reload started
+    std::vector<Binding> bindings;
+    uint32_t fadeFrames = 0;
+    bool fading = false; // set by the swap
+    RtSemaphore fadeDone;
+};
+
+// Thread owning libpd, between two ticks: the prepared instance becomes the live
+// one. The retired instance keeps rendering for the crossfade when a DSP thread
+// runs, otherwise it is handed back at once.
+void PdEngine::SwapInstance(PdReload &reload, bool rendering)
+{
+#ifdef HAVE_LIBPD
+    // Ce qui a été envoyé avant le swap va encore à l'ancienne instance
+    DrainCommands();
+    for (PdReload::Binding &binding : reload.bindings)
+        std::swap(*binding.slot, binding.handle);
+    std::swap(instance_, reload.instance);
+    libpd_set_instance(instance_);
+    libpd_set_instancedata(this, nullptr);
+    ++instanceEpoch_;
+    reload.fading = rendering && reload.fadeFrames > 0;
+    if (reload.fading)
+    {
+        fadeInstance_ = reload.instance;
+        fadeFrames_ = reload.fadeFrames;
+        fadePos_ = 0;
+        fadeDone_ = &reload.fadeDone;
+    }
+#else
+    (void)reload;
+    (void)rendering;
+#endif
+}
+
+// DSP thread, once the live instance rendered out: renders the retired one and
+// mixes it out with an equal-power curve (sin/cos, constant summed power)
+void PdEngine::CrossfadeTick(const float *in, float *out)
+{
+#ifdef HAVE_LIBPD
+    const uint32_t channels = (uint32_t)channelsOut_;
+    float *old = fadeScratch_.Data();
+    libpd_set_instance(fadeInstance_);
+    if (libpd_process_float(1, in, old) != 0)
+        memset(old, 0, (size_t)kPdBlockSize * channels * sizeof(float));
+    libpd_set_instance(instance_);
+
+    const float halfPi = 1.57079632679f;
+    const float step = 1.0f / (float)fadeFrames_;
+    for (uint32_t f = 0; f < kPdBlockSize; ++f)
+    {
+        const float x = std::min(1.0f, (float)(fadePos_ + f) * step) * halfPi;
+        const float gainNew = std::sin(x);
+        const float gainOld = std::cos(x);
+        for (uint32_t c = 0; c < channels; ++c)
+        {
+            const size_t i = (size_t)f * channels + c;
+            out[i] = out[i] * gainNew + old[i] * gainOld;
+        }
+    }
+    fadePos_ += kPdBlockSize;
+    if (fadePos_ >= fadeFrames_)
+        EndCrossfade();
+#else
+    (void)in;
+    (void)out;
+#endif
+}
+
+// Thread owning libpd: the retired instance will not be rendered again
+void PdEngine::EndCrossfade()
+{
+    if (!fadeInstance_)
+        return;
+    fadeInstance_ = nullptr;
+    fadeDone_->Post();
+    fadeDone_ = nullptr;
+}
+
+// Before every tick: forward the parameter slots whose generation moved
+void PdEngine::ScanParamBlocks()
+{
+    uint64_t sent = 0;
+    for (int b = 0; b < kMaxParamBlocks; ++b)
+    {
+        ParamBlock *block = paramBlocks_[b].load(std::memory_order_acquire);
+        if (!block)
+            break;
+        for (uint32_t i = 0; i < block->count; ++i)
+        {
+            const int32_t generation = block->generations[i].load(std::memory_order_acquire);
+            if (generation == block->seen[i])
+                continue;
+            block->seen[i] = generation;
+#ifdef HAVE_LIBPD
+            SendToHandle(block->handles[i], instanceEpoch_, false, block->values[i].load(std::memory_order_relaxed));
+#endif
+            ++sent;
+        }
+    }
+    if (sent)
+        paramDispatches_.fetch_add(sent, std::memory_order_relaxed);
+}
+
+// Before every tick: the pending array request, if any, runs between two ticks
+void PdEngine::RunRequest(bool rendering)
+{
+    if (!request_.load(std::memory_order_relaxed))
+        return;
+    // Le JS peut avoir annulé entre-temps (délai expiré) : l'échange tranche
+    PdRequest *op = request_.exchange(nullptr, std::memory_order_acq_rel);
+    if (!op)
+        return;
+    ExecuteRequest(*op, rendering);
+    op->done->Post();
+}
+
+// JS thread: with no DSP thread, runs a request a loadArray worker left waiting
+void PdEngine::ServiceRequests()
+{
+    if (DspThreadActive())
+        return;
+    SelectInstance();
+    RunRequest(false);
+}
+
+// Requester side: waits for the mailbox to be free (another requester's op
+// leaves it within a tick), false on timeout
+bool PdEngine::PostRequest(PdRequest &op, uint32_t timeoutMs)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;)
+    {
+        PdRequest *expected = nullptr;
+        if (request_.compare_exchange_weak(expected, &op, std::memory_order_release, std::memory_order_relaxed))
+            return true;
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+// Requester side: false if nobody picked op up in time (it is withdrawn then)
+bool PdEngine::WaitRequest(PdRequest &op, uint32_t timeoutMs)
+{
+    if (op.done->WaitFor(timeoutMs))
+        return true;
+    PdRequest *expected = &op;
+    if (request_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+        return false;
+    // Déjà pris : la copie est en cours, done sera posté
+    op.done->Wait();
+    return true;
+}
+
+// Thread owning libpd
+void PdEngine::ExecuteRequest(PdRequest &op, bool rendering)
+{
+    if (op.type == PdRequestType::SwapInstance)
+    {
+        SwapInstance(*static_cast<PdReload *>(op.context), rendering);
+        op.result = 0;
+        return;
+    }
+    if (op.type == PdRequestType::OpenPatch || op.type == PdRequestType::ClosePatch)
+    {
+        // Le graphe DSP est tenu pendant tout l'appel : c'est ce temps qu'on publie
+        const auto begin = std::chrono::steady_clock::now();
+#ifdef HAVE_LIBPD
+        if (op.type == PdRequestType::OpenPatch)
+            op.patch = libpd_openfile(op.file, op.dir);
+        else
+        {
+            libpd_closefile(op.patch);
+            op.patch = nullptr;
+        }
+        op.result = op.type == PdRequestType::OpenPatch && !op.patch ? -1 : 0;
+#else
+        op.result = 0;
+#endif
+        RecordGraphHold(begin);
+        graphChanges_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+#ifdef HAVE_LIBPD
+    switch (op.type)
+    {
+    case PdRequestType::ArraySize:
+        op.result = libpd_arraysize(op.name);
+        break;
+    case PdRequestType::ArrayRead:
+        op.result = libpd_read_array(op.data, op.name, op.offset, op.count);
+        break;
+    case PdRequestType::ArrayWrite:
+        op.result = libpd_write_array(op.name, op.offset, op.data, op.count);
+        break;
+    case PdRequestType::ArrayResize:
+    {
+        // Redimensionner réalloue la table et reconstruit le graphe DSP : rien à
+        // faire si elle a déjà la bonne taille
+        op.result = libpd_arraysize(op.name);
+        if (op.result < 0)
+            break;
+        if (op.result == op.count)
+        {
+            op.result = 0;
+            break;
+        }
+        const auto begin = std::chrono::steady_clock::now();
+        op.result = libpd_resize_array(op.name, op.count);
+        RecordGraphHold(begin);
+        arrayResizes_.fetch_add(1, std::memory_order_relaxed);
+        break;
+    }
+    default:
+        break;
+    }
+#else
+    op.result = kPdArrayNotFound;
+#endif
+}
+
+// Thread owning libpd: publishes how long the DSP graph was held since `begin`
+void PdEngine::RecordGraphHold(std::chrono::steady_clock::time_point begin)
+{
+    const uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - begin)
+                            .count();
+    // Un seul thread possède libpd à la fois : pas besoin de CAS pour le max
+    graphHoldLastUs_.store(us, std::memory_order_relaxed);
+    if (us > graphHoldMaxUs_.load(std::memory_order_relaxed))
+        graphHoldMaxUs_.store(us, std::memory_order_relaxed);
+    graphHoldTotalUs_.fetch_add(us, std::memory_order_relaxed);
+}
+
+// Avant chaque tick : tout ce qui est dû avant la fin de ce tick, dans l'ordre des
+// temps (les messages en retard partent tout de suite)
+void PdEngine::DispatchScheduled()
+{
+    const uint64_t tickEnd = sampleTime_ + kPdBlockSize;
+    if (!scheduled_.Due(tickEnd))
+        return;
+    while (const PdCommand *cmd = scheduled_.Due(tickEnd))
+    {
+        DispatchCommand(*cmd);
+        scheduled_.Pop();
+    }
+    scheduledPending_.store((uint32_t)scheduled_.Size(), std::memory_order_relaxed);
+}
+
+void PdEngine::DispatchCommand(const PdCommand &cmd)
+{
+#ifdef HAVE_LIBPD
+    switch (cmd.type)
+    {
+    case PdCommandType::Bang:
+        libpd_bang(cmd.receiver);
+        break;
+    case PdCommandType::Float:
+        libpd_float(cmd.receiver, cmd.value);
+        break;
+    case PdCommandType::Symbol:
+        libpd_symbol(cmd.receiver, cmd.symbol);
+        break;
+    case PdCommandType::List:
+    {
+        t_atom argv[kPdMaxAtoms];
+        int argc = 0;
+        PdAtomReader reader(cmd.payload, cmd.size);
+        PdAtomView atom;
+        while (argc < (int)kPdMaxAtoms && reader.Next(atom))
+        {
+            if (atom.isSymbol)
+                libpd_set_symbol(&argv[argc++], atom.s);
+            else
+                libpd_set_float(&argv[argc++], atom.f);
+        }
+        libpd_list(cmd.receiver, argc, argv);
+        break;
+    }
+    case PdCommandType::HandleBang:
+    case PdCommandType::HandleFloat:
+        SendToHandle(static_cast<PdReceiverHandle *>(cmd.ptr), instanceEpoch_, cmd.type == PdCommandType::HandleBang,
+                     cmd.value);
+        break;
+    case PdCommandType::Bind:
+        *static_cast<void **>(cmd.ptr) = libpd_bind(cmd.receiver);
+        break;
+    case PdCommandType::Unbind:
+    {
+        void **binding = static_cast<void **>(cmd.ptr);
+        if (*binding)
+        {
+            libpd_unbind(*binding);
+            *binding = nullptr;
+        }
+        break;
+    }
+    case PdCommandType::NoteOn:
+        libpd_noteon(cmd.midi[0], cmd.midi[1], cmd.midi[2]);
+        break;
+    case PdCommandType::ControlChange:
+        libpd_controlchange(cmd.midi[0], cmd.midi[1], cmd.midi[2]);
+        break;
+    case PdCommandType::ProgramChange:
+        libpd_programchange(cmd.midi[0], cmd.midi[1]);
+        break;
+    case PdCommandType::PitchBend:
+        libpd_pitchbend(cmd.midi[0], cmd.midi[1]);
+        break;
+    case PdCommandType::Aftertouch:
+        libpd_aftertouch(cmd.midi[0], cmd.midi[1]);
+        break;
+    case PdCommandType::PolyAftertouch:
+        libpd_polyaftertouch(cmd.midi[0], cmd.midi[1], cmd.midi[2]);
+        break;
+    case PdCommandType::MidiBytes:
+        for (uint16_t i = 0; i < cmd.size; ++i)
+            libpd_midibyte(cmd.midi[0], cmd.payload[i]);
+        break;
+    }
+#else
+    (void)cmd;
+#endif
+}
+
+// Offline rendering: the same period loop as the device callback (tick FIFO,
+// whole ticks straight into the output, master gain), driven as fast as libpd
+// goes, in chunks of blockSize_ frames. No capture: TickInput() feeds silence.
+void PdEngine::RenderOffline(float *out, uint32_t frames)
+{
+    // Thread JS ou thread du pool libuv, partagé avec d'autres moteurs
+    SelectInstance();
+    ScopedDenormalGuard denormals(denormalProtection_);
+    const uint32_t period = (uint32_t)blockSize_;
+    const size_t channels = (size_t)channelsOut_;
+    for (uint32_t pos = 0; pos < frames; pos += period)
+    {
+        const uint32_t n = frames - pos < period ? frames - pos : period;
+        AudioCallback(out + (size_t)pos * channels, nullptr, n);
+    }
+}
+
+// JS thread: validates (length, out?) and sets up libpd and the buffers on first
+// use. Throws and returns false on error.
+bool PdEngine::PrepareOfflineRender(const Napi::CallbackInfo &info, Napi::Float32Array &out, uint32_t &frames)
+{
+    Napi::Env env = info.Env();
+    if (running_ || offlineBusy_ || mixerAttached_)
+    {
+        Napi::Error::New(env, running_         ? "cannot render offline while the device is running"
+                              : offlineBusy_ ? "offline render in progress"
+                                             : "engine is attached to a PdMixer")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+
+    double count = -1.0;
+    if (info.Length() >= 1 && info[0].IsNumber())
+    {
+        count = info[0].As<Napi::Number>().DoubleValue() * sampleRate_;
+    }
+    else if (info.Length() >= 1 && info[0].IsObject())
+    {
+        Napi::Object obj = info[0].As<Napi::Object>();
+        if (obj.Has("frames"))
+            count = obj.Get("frames").ToNumber().DoubleValue();
+        else if (obj.Has("seconds"))
+            count = obj.Get("seconds").ToNumber().DoubleValue() * sampleRate_;
+    }
+    if (!(count >= 0.0))
+    {
+        Napi::TypeError::New(env, "(seconds: number | { frames?: number, seconds?: number }, out?: Float32Array)")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+    const size_t channels = (size_t)channelsOut_;
+    if (count * channels > (double)UINT32_MAX)
+    {
+        Napi::RangeError::New(env, "render length too large").ThrowAsJavaScriptException();
+        return false;
+    }
+    frames = (uint32_t)std::lround(count);
+
+    if (info.Length() >= 2 && !info[1].IsUndefined())
+    {
+        if (!info[1].IsTypedArray() || info[1].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array)
+        {
+            Napi::TypeError::New(env, "out must be a Float32Array").ThrowAsJavaScriptException();
+            return false;
+        }
+        out = info[1].As<Napi::Float32Array>();
+        if (out.ElementLength() < (size_t)frames * channels)
+        {
+            Napi::RangeError::New(env, "out is smaller than frames * channelsOut").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+    else
+    {
+        out = Napi::Float32Array::New(env, (size_t)frames * channels);
+    }
+
+    if (!offlineReady_)
+    {
+        StartDsp();
+        AllocateBuffers();
+        offlineReady_ = true;
+    }
+    return true;
+}
+
+void PdEngine::FinishOfflineRender()
+{
+    // Retour au mode direct : ce que le JS a envoyé pendant le rendu est traité ici
+    dspActive_ = false;
+    ReclaimDsp();
+    offlineBusy_ = false;
+}
+
+// JS thread, mixer stopped: prepares libpd and the buffers for a mixer of the
+// same sample rate and channel count. Throws and returns false on error.
+bool PdEngine::AttachMixer(Napi::Env env, uint32_t maxFrames)
+{
+    if (running_ || offlineBusy_ || mixerAttached_)
+    {
+        Napi::Error::New(env, mixerAttached_ ? "engine is already attached to a PdMixer"
+                                             : "engine must be stopped to join a PdMixer")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+    StartDsp();
+    AllocateBuffers();
+    mixOut_.Allocate((size_t)maxFrames * (size_t)channelsOut_);
+    offlineReady_ = false;
+    mixerAttached_ = true;
+    return true;
+}
+
+void PdEngine::DetachMixer()
+{
+    SetMixerRunning(false);
+    mixOut_.Release();
+    mixerAttached_ = false;
+}
+
+// JS thread, around the mixer's start()/stop(): libpd belongs to the mixer's
+// threads in between, sends are queued as with a device of our own
+void PdEngine::SetMixerRunning(bool running)
+{
+    if (running)
+    {
+        dspActive_ = true;
+        return;
+    }
+    if (!dspActive_)
+        return;
+    dspActive_ = false;
+    ReclaimDsp();
+}
+
+// Mixer device callback or worker thread: one period of this engine into mixOut_
+const float *PdEngine::RenderForMixer(uint32_t frames)
+{
+    SelectInstance();
+    float *out = mixOut_.Data();
+    AudioCallback(out, nullptr, frames);
+    return out;
+}
+
+// render(seconds | { frames } | { seconds }, out?) -> Float32Array, interleaved
+// channelsOut frames. Runs on the calling thread.
+Napi::Value PdEngine::render(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::Float32Array out;
+    uint32_t frames = 0;
+    if (!PrepareOfflineRender(info, out, frames))
+        return env.Undefined();
+    RenderOffline(out.Data(), frames);
+    return out;
+}
+
+// renderAsync runs the loop on a libuv worker. libpd belongs to that worker until
+// the promise settles: sends are queued like with a running device.
+class OfflineRenderWorker : public Napi::AsyncWorker
+{
+public:
+    OfflineRenderWorker(Napi::Env env, PdEngine *engine, Napi::Object self, Napi::Float32Array out, uint32_t frames)
+        : Napi::AsyncWorker(env, "PdEngine.renderAsync"), deferred_(Napi::Promise::Deferred::New(env)),
+          engine_(engine), data_(out.Data()), frames_(frames)
+    {
+        // Le moteur et le buffer de sortie restent vivants jusqu'à la fin du rendu
+        self_ = Napi::Persistent(self);
+        out_ = Napi::Persistent(static_cast<Napi::Object>(out));
+    }
+
+    Napi::Promise Promise() const { return deferred_.Promise(); }
+
+protected:
+    void Execute() override { engine_->RenderOffline(data_, frames_); }
+
+    void OnOK() override
+    {
+        engine_->FinishOfflineRender();
+        deferred_.Resolve(out_.Value());
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        engine_->FinishOfflineRender();
+        deferred_.Reject(error.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    PdEngine *engine_;
+    Napi::ObjectReference self_;
+    Napi::ObjectReference out_;
+    float *data_;
+    uint32_t frames_;
+};
+
+Napi::Value PdEngine::renderAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::Float32Array out;
+    uint32_t frames = 0;
+    if (!PrepareOfflineRender(info, out, frames))
+        return env.Undefined();
+    auto *worker = new OfflineRenderWorker(env, this, info.This().As<Napi::Object>(), out, frames);
+    offlineBusy_ = true;
+    dspActive_ = true;
+    worker->Queue();
+    return worker->Promise();
+}
+
+Napi::Value PdEngine::openPatch(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (offlineBusy_)
+    {
+        Napi::Error::New(env, "offline render in progress").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (reloading_)
+    {
+        Napi::Error::New(env, "patch reload in progress").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "path string required").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    std::string dir, name;
+    splitPath(path, dir, name);
+    // Audio en cours : c'est le thread DSP qui instancie, entre deux ticks
+    PdRequest op{};
+    op.type = PdRequestType::OpenPatch;
+    op.dir = dir.c_str();
+    op.file = name.c_str();
+    if (!SyncRequest(env, op))
+        return env.Undefined();
+#ifdef HAVE_LIBPD
+    patch_ = op.patch;
+    if (!patch_)
+    {
+        Napi::Error::New(env, "Failed to open patch").ThrowAsJavaScriptException();
+    }
+#endif
+    return env.Undefined();
+}
+
+Napi::Value PdEngine::closePatch(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (offlineBusy_)
+    {
+        Napi::Error::New(env, "offline render in progress").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (reloading_)
+    {
+        Napi::Error::New(env, "patch reload in progress").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+#ifdef HAVE_LIBPD
+    if (patch_)
+    {
+        PdRequest op{};
+        op.type = PdRequestType::ClosePatch;
+        op.patch = patch_;
+        if (!SyncRequest(env, op))
+            return env.Undefined();
+        patch_ = nullptr;
+    }
+#endif
+    return env.Undefined();
+}
+
+// Sample clock values arrive as Number or BigInt; 0 and negatives mean "now"
+static bool ReadSampleTime(const Napi::Value &value, uint64_t &time)
+{
+    if (value.IsBigInt())
+    {
+        bool lossless = true;
+        int64_t t = value.As<Napi::BigInt>().Int64Value(&lossless);
+        time = t > 0 ? (uint64_t)t : 0;
+        return true;
+    }
+    if (!value.IsNumber())
+        return false;
+    const double t = value.As<Napi::Number>().DoubleValue();
+    if (!std::isfinite(t))
+        return false;
+    time = t > 0.0 ? (uint64_t)t : 0;
+    return true;
+}
+
+// Encodes a JS array of numbers and strings; false if an element has another type
+// or the list does not fit in the payload
+static bool EncodeList(const Napi::Array &list, PdCommand &cmd, bool &tooLong)
+{
+    PdAtomWriter writer(cmd.payload, sizeof(cmd.payload));
+    tooLong = false;
+    for (uint32_t i = 0; i < list.Length(); ++i)
+    {
+        Napi::Value item = list.Get(i);
+        bool ok;
+        if (item.IsNumber())
+            ok = writer.AddFloat(item.As<Napi::Number>().FloatValue());
+        else if (item.IsString())
+        {
+            std::string sym = item.As<Napi::String>().Utf8Value();
+            ok = writer.AddSymbol(sym.data(), sym.size());
+        }
+        else
+            return false;
+        if (!ok)
+        {
+            tooLong = true;
+            return false;
+        }
+    }
+    cmd.argc = writer.Count();
+    cmd.size = (uint16_t)writer.Size();
+    return true;
+}
+
+// send*(receiver, value?) and send*At(receiver, value?, sampleTime)
+Napi::Value PdEngine::SendCommand(const Napi::CallbackInfo &info, PdCommandType type, bool timed)
+{
+    Napi::Env env = info.Env();
+    const size_t valueArgs = type == PdCommandType::Bang ? 0 : 1;
+    bool valid = info.Length() >= 1 + valueArgs + (timed ? 1 : 0) && info[0].IsString();
+    if (valid && valueArgs)
+    {
+        switch (type)
+        {
+        case PdCommandType::Float:
+            valid = info[1].IsNumber();
+            break;
+        case PdCommandType::Symbol:
+            valid = info[1].IsString();
+            break;
+        default:
+            valid = info[1].IsArray();
+            break;
+        }
+    }
+    PdCommand cmd{};
+    cmd.type = type;
+    if (valid && timed)
+        valid = ReadSampleTime(info[1 + valueArgs], cmd.time);
+    if (!valid)
+    {
+        static const char *const usage[] = {"(receiver: string", "(receiver: string, value: number",
+                                            "(receiver: string, symbol: string",
+                                            "(receiver: string, list: (number | string)[]"};
+        std::string text = usage[(int)type];
+        text += timed ? ", sampleTime: number | bigint)" : ")";
+        Napi::TypeError::New(env, text).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::string recv = info[0].As<Napi::String>().Utf8Value();
+    if (!CopyPdName(cmd.receiver, recv.data(), recv.size()))
+    {
+        Napi::RangeError::New(env, "receiver name too long").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (type == PdCommandType::Float)
+    {
+        cmd.value = info[1].As<Napi::Number>().FloatValue();
+    }
+    else if (type == PdCommandType::Symbol)
+    {
+        std::string sym = info[1].As<Napi::String>().Utf8Value();
+        if (!CopyPdName(cmd.symbol, sym.data(), sym.size()))
+        {
+            Napi::RangeError::New(env, "symbol too long").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    else if (type == PdCommandType::List)
+    {
+        bool tooLong;
+        if (!EncodeList(info[1].As<Napi::Array>(), cmd, tooLong))
+        {
+            if (tooLong)
+                Napi::RangeError::New(env, "list too long").ThrowAsJavaScriptException();
+            else
+                Napi::TypeError::New(env, "list items must be numbers or strings").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    return Napi::Boolean::New(env, PostCommand(cmd));
+}
+
+Napi::Value PdEngine::sendBang(const Napi::CallbackInfo &info)
+{
+    return SendCommand(info, PdCommandType::Bang, false);
+}
+
+Napi::Value PdEngine::sendFloat(const Napi::CallbackInfo &info)
+{
+    return SendCommand(info, PdCommandType::Float, false);
+}
+
+Napi::Value PdEngine::sendSymbol(const Napi::CallbackInfo &info)
+{
+    return SendCommand(info, PdCommandType::Symbol, false);
+}
+
+Napi::Value PdEngine::sendList(const Napi::CallbackInfo &info)
+{
+    return SendCommand(info, PdCommandType::List, false);
+}
+
+Napi::Value PdEngine::sendBangAt(const Napi::CallbackInfo &info)
+{
+    return SendCommand(info, PdCommandType::Bang, true);
+}
+
+Napi::Value PdEngine::sendFloatAt(const Napi::CallbackInfo &info)
+{
+    return SendCommand(info, PdCommandType::Float, true);
+}
+
+Napi::Value PdEngine::sendSymbolAt(const Napi::CallbackInfo &info)
+{
+    return SendCommand(info, PdCommandType::Symbol, true);
+}
+
+Napi::Value PdEngine::sendListAt(const Napi::CallbackInfo &info)
+{
+    return SendCommand(info, PdCommandType::List, true);
+}
+
+// sendBatch(ArrayBuffer | TypedArray) -> number of commands queued. Records are
+// decoded straight into the queue slots (pd_batch.h); once the queue is full the
+// rest are counted as overflows. A malformed record throws, the records before it
+// have already been queued.
+Napi::Value PdEngine::sendBatch(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    const uint8_t *data = nullptr;
+    size_t length = 0;
+    if (info.Length() >= 1 && info[0].IsArrayBuffer())
+    {
+        Napi::ArrayBuffer buffer = info[0].As<Napi::ArrayBuffer>();
+        data = static_cast<const uint8_t *>(buffer.Data());
+        length = buffer.ByteLength();
+    }
+    else if (info.Length() >= 1 && info[0].IsTypedArray())
+    {
+        Napi::TypedArray view = info[0].As<Napi::TypedArray>();
+        data = static_cast<const uint8_t *>(view.ArrayBuffer().Data()) + view.ByteOffset();
+        length = view.ByteLength();
+    }
+    else
+    {
+        Napi::TypeError::New(env, "(batch: ArrayBuffer | Uint8Array)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    const bool direct = !DspThreadActive();
+    if (direct)
+        SelectInstance();
+    PdCommand local{};
+    bool full = false;
+    uint32_t queued = 0;
+    size_t pos = 0;
+    while (pos < length)
+    {
+        PdCommand *cmd = &local;
+        if (!direct && !full)
+        {
+            cmd = commands_.BeginPush();
+            if (!cmd)
+            {
+                full = true;
+                cmd = &local;
+            }
+        }
+        const size_t size = DecodePdBatchRecord(data + pos, length - pos, *cmd);
+        if (size == 0)
+        {
+            Napi::RangeError::New(env, "malformed batch record at byte " + std::to_string(pos))
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        pos += size;
+        if (direct)
+        {
+            if (cmd->time != 0)
+                Schedule(*cmd);
+            else
+                DispatchCommand(*cmd);
+            ++queued;
+        }
+        else if (full)
+        {
+            commandOverflows_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            commands_.CommitPush();
+            ++queued;
+        }
+    }
+    return Napi::Number::New(env, queued);
+}
+
+// MIDI commands sent by SendMidi: data arguments after the channel, with ranges
+struct MidiSignature
+{
+    const char *usage;
+    int dataArgs;
+    int32_t min[2];
+    int32_t max[2];
+};
+
+static const MidiSignature kMidiSignatures[] = {
+    {"(channel: number, pitch: number, velocity: number", 2, {0, 0}, {127, 127}},
+    {"(channel: number, controller: number, value: number", 2, {0, 0}, {127, 127}},
+    {"(channel: number, program: number", 1, {0, 0}, {127, 0}},
+    {"(channel: number, value: number", 1, {-8192, 0}, {8191, 0}},
+    {"(channel: number, value: number", 1, {0, 0}, {127, 0}},
+    {"(channel: number, pitch: number, value: number", 2, {0, 0}, {127, 127}},
+};
+
+// Integer argument in [min, max]; NaN fails the comparison
+static bool ReadMidiValue(const Napi::Value &value, int32_t min, int32_t max, int32_t &out)
+{
+    if (!value.IsNumber())
+        return false;
+    const double v = value.As<Napi::Number>().DoubleValue();
+    if (!(v >= min && v <= max))
+        return false;
+    out = (int32_t)v;
+    return true;
+}
+
+// sendNoteOn(channel, pitch, velocity, sampleTime?) and friends. channel is the
+// libpd channel: 0-15 on the first port, 16-31 on the second, and so on.
+Napi::Value PdEngine::SendMidi(const Napi::CallbackInfo &info, PdCommandType type)
+{
+    Napi::Env env = info.Env();
+    const MidiSignature &sig = kMidiSignatures[(int)type - (int)PdCommandType::NoteOn];
+    PdCommand cmd{};
+    cmd.type = type;
+    bool valid = info.Length() >= (size_t)(1 + sig.dataArgs) && info[0].IsNumber();
+    for (int i = 0; valid && i <= sig.dataArgs; ++i)
+        valid = info[i].IsNumber();
+    if (valid && info.Length() > (size_t)(1 + sig.dataArgs) && !info[1 + sig.dataArgs].IsUndefined())
+        valid = ReadSampleTime(info[1 + sig.dataArgs], cmd.time);
+    if (!valid)
+    {
+        Napi::TypeError::New(env, std::string(sig.usage) + ", sampleTime?: number | bigint)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!ReadMidiValue(info[0], 0, kPdMidiChannels - 1, cmd.midi[0]))
+    {
+        Napi::RangeError::New(env, "MIDI channel out of range").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    for (int i = 0; i < sig.dataArgs; ++i)
+    {
+        if (!ReadMidiValue(info[1 + i], sig.min[i], sig.max[i], cmd.midi[1 + i]))
+        {
+            Napi::RangeError::New(env, "MIDI value out of range").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    return Napi::Boolean::New(env, PostCommand(cmd));
+}
+
+Napi::Value PdEngine::sendNoteOn(const Napi::CallbackInfo &info)
+{
+    return SendMidi(info, PdCommandType::NoteOn);
+}
+
+Napi::Value PdEngine::sendCC(const Napi::CallbackInfo &info)
+{
+    return SendMidi(info, PdCommandType::ControlChange);
+}
+
+Napi::Value PdEngine::sendProgramChange(const Napi::CallbackInfo &info)
+{
+    return SendMidi(info, PdCommandType::ProgramChange);
+}
+
+Napi::Value PdEngine::sendPitchBend(const Napi::CallbackInfo &info)
+{
+    return SendMidi(info, PdCommandType::PitchBend);
+}
+
+Napi::Value PdEngine::sendAftertouch(const Napi::CallbackInfo &info)
+{
+    return SendMidi(info, PdCommandType::Aftertouch);
+}
+
+Napi::Value PdEngine::sendPolyAftertouch(const Napi::CallbackInfo &info)
+{
+    return SendMidi(info, PdCommandType::PolyAftertouch);
+}
+
+// sendMidiBytes(port, bytes: Uint8Array | number[], sampleTime?) -> boolean: raw
+// bytes for [midiin]/[sysexin], split into commands of up to 240 bytes that stay
+// in order. false if the queue filled up on the way.
+Napi::Value PdEngine::sendMidiBytes(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    PdCommand cmd{};
+    cmd.type = PdCommandType::MidiBytes;
+    bool valid = info.Length() >= 2 && info[0].IsNumber() &&
+                 (info[1].IsArray() ||
+                  (info[1].IsTypedArray() && info[1].As<Napi::TypedArray>().TypedArrayType() == napi_uint8_array));
+    if (valid && info.Length() > 2 && !info[2].IsUndefined())
+        valid = ReadSampleTime(info[2], cmd.time);
+    if (!valid)
+    {
+        Napi::TypeError::New(env, "(port: number, bytes: Uint8Array | number[], sampleTime?: number | bigint)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!ReadMidiValue(info[0], 0, kPdMidiChannels / 16 - 1, cmd.midi[0]))
+    {
+        Napi::RangeError::New(env, "MIDI port out of range").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::vector<uint8_t> bytes;
+    if (info[1].IsArray())
+    {
+        Napi::Array list = info[1].As<Napi::Array>();
+        bytes.resize(list.Length());
+        for (uint32_t i = 0; i < list.Length(); ++i)
+        {
+            int32_t b;
+            if (!ReadMidiValue(list.Get(i), 0, 255, b))
+            {
+                Napi::RangeError::New(env, "MIDI byte out of range at index " + std::to_string(i))
+                    .ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            bytes[i] = (uint8_t)b;
+        }
+    }
+    else
+    {
+        Napi::Uint8Array view = info[1].As<Napi::Uint8Array>();
+        bytes.assign(view.Data(), view.Data() + view.ElementLength());
+    }
+
+    bool ok = true;
+    for (size_t pos = 0; pos < bytes.size(); pos += sizeof(cmd.payload))
+    {
+        const size_t n = std::min(bytes.size() - pos, sizeof(cmd.payload));
+        std::memcpy(cmd.payload, bytes.data() + pos, n);
+        cmd.size = (uint16_t)n;
+        ok = PostCommand(cmd) && ok;
+    }
+    return Napi::Boolean::New(env, ok);
+}
+
+// JS thread: one channel voice message (pd_midi.h), written straight into the
+// queue slot like sendBatch records. false once the queue is full.
+bool PdEngine::PostMidi(uint8_t status, uint8_t data1, uint8_t data2, uint64_t time)
+{
+    if (!DspThreadActive())
+    {
+        PdCommand cmd{};
+        DecodeMidiMessage(status, data1, data2, 0, cmd);
+        cmd.time = time;
+        if (time != 0)
+        {
+            Schedule(cmd);
+            return true;
+        }
+        SelectInstance();
+        DispatchCommand(cmd);
+        return true;
+    }
+    PdCommand *slot = commands_.BeginPush();
+    if (!slot)
+    {
+        commandOverflows_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    DecodeMidiMessage(status, data1, data2, 0, *slot);
+    slot->time = time;
+    commands_.CommitPush();
+    return true;
+}
+
+// sendMidiBatch(data, sampleTime?) -> number of messages queued, for dense
+// controller streams. Channel voice messages only, on the first port:
+//   Uint8Array    MIDI byte stream (running status allowed), all due at
+//                 sampleTime, or now without it
+//   Float32Array  records of 4 floats [status, data1, data2, offset]: each due
+//                 offset samples after sampleTime (default: the current sample
+//                 clock), offset 0 without sampleTime meaning now
+// As with sendBatch, a malformed message throws after the ones before it were
+// queued, and messages that do not fit in the queue count as overflows.
+Napi::Value PdEngine::sendMidiBatch(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    bool bytes = false;
+    bool valid = info.Length() >= 1 && info[0].IsTypedArray();
+    if (valid)
+    {
+        const napi_typedarray_type type = info[0].As<Napi::TypedArray>().TypedArrayType();
+        bytes = type == napi_uint8_array;
+        valid = bytes || type == napi_float32_array;
+    }
+    uint64_t base = 0;
+    const bool timed = info.Length() > 1 && !info[1].IsUndefined();
+    if (valid && timed)
+        valid = ReadSampleTime(info[1], base);
+    if (!valid)
+    {
+        Napi::TypeError::New(env, "(data: Uint8Array | Float32Array, sampleTime?: number | bigint)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    uint32_t queued = 0;
+    if (bytes)
+    {
+        Napi::Uint8Array view = info[0].As<Napi::Uint8Array>();
+        const uint8_t *data = view.Data();
+        const size_t length = view.ElementLength();
+        uint8_t status = 0;
+        size_t pos = 0;
+        while (pos < length)
+        {
+            const size_t start = pos;
+            if (data[pos] & 0x80)
+                status = data[pos++];
+            const size_t dataBytes = MidiMessageLength(status) - 1;
+            // Pas de SysEx ni de messages système ici : sendMidiBytes
+            if (status < 0x80 || status >= 0xF0 || pos + dataBytes > length || (data[pos] & 0x80) ||
+                (dataBytes > 1 && (data[pos + 1] & 0x80)))
+            {
+                Napi::RangeError::New(env, "malformed MIDI message at byte " + std::to_string(start))
+                    .ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            if (PostMidi(status, data[pos], dataBytes > 1 ? data[pos + 1] : 0, base))
+                ++queued;
+            pos += dataBytes;
+        }
+        return Napi::Number::New(env, queued);
+    }
+
+    Napi::Float32Array view = info[0].As<Napi::Float32Array>();
+    const float *data = view.Data();
+    const size_t records = view.ElementLength() / 4;
+    if (!timed)
+        base = sampleClock_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < records; ++i)
+    {
+        const float *r = data + 4 * i;
+        if (!(r[0] >= 128.0f && r[0] < 240.0f && r[1] >= 0.0f && r[1] < 128.0f && r[2] >= 0.0f && r[2] < 128.0f &&
+              r[3] >= 0.0f && r[3] < 4294967296.0f))
+        {
+            Napi::RangeError::New(env, "malformed MIDI record at index " + std::to_string(i))
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        const uint64_t offset = (uint64_t)r[3];
+        const uint64_t time = timed || offset != 0 ? base + offset : 0;
+        if (PostMidi((uint8_t)r[0], (uint8_t)r[1], (uint8_t)r[2], time))
+            ++queued;
+    }
+    return Napi::Number::New(env, queued);
+}
+
+// JS thread: handle cached per name, nullptr if the name is too long
+PdReceiverHandle *PdEngine::ReceiverHandle(const std::string &name)
+{
+    if (name.size() >= kPdMaxNameLength)
+        return nullptr;
+    std::unique_ptr<PdReceiverHandle> &handle = receivers_[name];
+    if (!handle)
+    {
+        handle.reset(new PdReceiverHandle());
+        CopyPdName(handle->name, name.data(), name.size());
+    }
+    return handle.get();
+}
+
+// receiver(name) -> PdReceiver bound to a handle cached per name
+Napi::Value PdEngine::receiver(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "(receiver: string)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    PdReceiverHandle *handle = ReceiverHandle(info[0].As<Napi::String>().Utf8Value());
+    if (!handle)
+    {
+        Napi::RangeError::New(env, "receiver name too long").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return PdReceiver::New(env, info.This().As<Napi::Object>(), handle);
+}
+
+// attachParamBlock(values: Float32Array, generations: Int32Array, names: string[])
+// Low-level half of engine.createParamBlock() (index.js), which allocates the
+// SharedArrayBuffer: N-API cannot create one.
+Napi::Value PdEngine::attachParamBlock(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 3 || !info[0].IsTypedArray() || !info[1].IsTypedArray() || !info[2].IsArray() ||
+        info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array ||
+        info[1].As<Napi::TypedArray>().TypedArrayType() != napi_int32_array)
+    {
+        Napi::TypeError::New(env, "(values: Float32Array, generations: Int32Array, names: string[])")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Float32Array values = info[0].As<Napi::Float32Array>();
+    Napi::Int32Array generations = info[1].As<Napi::Int32Array>();
+    Napi::Array names = info[2].As<Napi::Array>();
+    const uint32_t count = names.Length();
+    if (values.ElementLength() < count || generations.ElementLength() < count)
+    {
+        Napi::RangeError::New(env, "values and generations need one slot per name").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (paramBlockStorage_.size() >= (size_t)kMaxParamBlocks)
+    {
+        Napi::RangeError::New(env, "too many parameter blocks").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::unique_ptr<ParamBlock> block(new ParamBlock());
+    block->count = count;
+    block->values = reinterpret_cast<const std::atomic<float> *>(values.Data());
+    block->generations = reinterpret_cast<const std::atomic<int32_t> *>(generations.Data());
+    block->handles.reset(new PdReceiverHandle *[count]);
+    block->seen.reset(new int32_t[count]);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Napi::Value name = names.Get(i);
+        PdReceiverHandle *handle = name.IsString() ? ReceiverHandle(name.As<Napi::String>().Utf8Value()) : nullptr;
+        if (!handle)
+        {
+            Napi::TypeError::New(env, "names must be strings shorter than 64 bytes").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        block->handles[i] = handle;
+        // Rien n'est envoyé à l'attache : seules les écritures suivantes comptent
+        block->seen[i] = block->generations[i].load(std::memory_order_relaxed);
+    }
+
+    paramBlockRefs_.push_back(Napi::Persistent(static_cast<Napi::Object>(values)));
+    paramBlockRefs_.push_back(Napi::Persistent(static_cast<Napi::Object>(generations)));
+    const size_t index = paramBlockStorage_.size();
+    paramBlockStorage_.push_back(std::move(block));
+    paramBlocks_[index].store(paramBlockStorage_.back().get(), std::memory_order_release);
+    return Napi::Number::New(env, (double)index);
+}
+
+// JS thread: runs op on the thread that owns libpd and waits for it. Throws and
+// returns false if it could not run.
+bool PdEngine::SyncRequest(Napi::Env env, PdRequest &op)
+{
+    if (offlineBusy_)
+    {
+        Napi::Error::New(env, "offline render in progress").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (!DspThreadActive())
+    {
+        SelectInstance();
+        ExecuteRequest(op, false);
+        return true;
+    }
+    op.done = &requestDone_;
+    if (!PostRequest(op, kRequestTimeoutMs) || !WaitRequest(op, kRequestTimeoutMs))
+    {
+        Napi::Error::New(env, "DSP thread did not run the request").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+// SyncRequest for array requests, libpd errors turned into exceptions
+bool PdEngine::ArrayRequest(Napi::Env env, PdRequest &op)
+{
+    if (!SyncRequest(env, op))
+        return false;
+    arrayOps_.fetch_add(1, std::memory_order_relaxed);
+    if (op.result == kPdArrayNotFound)
+    {
+        Napi::Error::New(env, std::string("array not found: ") + op.name).ThrowAsJavaScriptException();
+        return false;
+    }
+    if (op.result < 0)
+    {
+        Napi::RangeError::New(env, "array range out of bounds").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+// Array name argument, copied into op.name
+static bool ReadArrayName(const Napi::CallbackInfo &info, PdRequest &op, const char *usage)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, usage).ThrowAsJavaScriptException();
+        return false;
+    }
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    if (!CopyPdName(op.name, name.data(), name.size()))
+    {
+        Napi::RangeError::New(env, "array name too long").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+// Index or length argument: a non-negative integer that fits an int
+static bool ReadArrayIndex(const Napi::Value &value, int &out)
+{
+    if (!value.IsNumber())
+        return false;
+    const double v = value.As<Napi::Number>().DoubleValue();
+    if (!(v >= 0.0 && v <= (double)INT32_MAX) || v != std::floor(v))
+        return false;
+    out = (int)v;
+    return true;
+}
+
+// arraySize(name) -> number of elements
+Napi::Value PdEngine::arraySize(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    PdRequest op{};
+    op.type = PdRequestType::ArraySize;
+    if (!ReadArrayName(info, op, "(name: string)") || !ArrayRequest(env, op))
+        return env.Undefined();
+    return Napi::Number::New(env, op.result);
+}
+
+// readArray(name, offset = 0, n = rest of the array, target?) -> Float32Array.
+// Pd copies straight into target (or a new array of n elements).
+Napi::Value PdEngine::readArray(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    const char *usage = "(name: string, offset?: number, n?: number, target?: Float32Array)";
+    PdRequest op{};
+    op.type = PdRequestType::ArrayRead;
+    if (!ReadArrayName(info, op, usage))
+        return env.Undefined();
+    if (info.Length() > 1 && !info[1].IsUndefined() && !ReadArrayIndex(info[1], op.offset))
+    {
+        Napi::TypeError::New(env, usage).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Float32Array target;
+    const bool hasTarget = info.Length() > 3 && !info[3].IsUndefined();
+    if (hasTarget)
+    {
+        if (!info[3].IsTypedArray() || info[3].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array)
+        {
+            Napi::TypeError::New(env, usage).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        target = info[3].As<Napi::Float32Array>();
+    }
+
+    const bool hasCount = info.Length() > 2 && !info[2].IsUndefined();
+    if (hasCount)
+    {
+        if (!ReadArrayIndex(info[2], op.count))
+        {
+            Napi::TypeError::New(env, usage).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+    }
+    else if (hasTarget)
+        op.count = target.ElementLength() > (size_t)INT32_MAX ? INT32_MAX : (int)target.ElementLength();
+    else
+    {
+        // Le reste du tableau : sa taille d'abord, puis la lecture
+        PdRequest size = op;
+        size.type = PdRequestType::ArraySize;
+        if (!ArrayRequest(env, size))
+            return env.Undefined();
+        if (op.offset > size.result)
+        {
+            Napi::RangeError::New(env, "array range out of bounds").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        op.count = size.result - op.offset;
+    }
+
+    if (!hasTarget)
+        target = Napi::Float32Array::New(env, (size_t)op.count);
+    else if (target.ElementLength() < (size_t)op.count)
+    {
+        Napi::RangeError::New(env, "target is shorter than n").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    op.data = target.Data();
+    if (!ArrayRequest(env, op))
+        return env.Undefined();
+    return target;
+}
+
+// writeArray(name, offset, source: Float32Array) -> number of elements written.
+// Pd copies straight from source.
+Napi::Value PdEngine::writeArray(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    const char *usage = "(name: string, offset: number, source: Float32Array)";
+    PdRequest op{};
+    op.type = PdRequestType::ArrayWrite;
+    if (!ReadArrayName(info, op, usage))
+        return env.Undefined();
+    if (info.Length() < 3 || !ReadArrayIndex(info[1], op.offset) || !info[2].IsTypedArray() ||
+        info[2].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array)
+    {
+        Napi::TypeError::New(env, usage).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::Float32Array source = info[2].As<Napi::Float32Array>();
+    if (source.ElementLength() > (size_t)INT32_MAX)
+    {
+        Napi::RangeError::New(env, "source too large").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    op.data = source.Data();
+    op.count = (int)source.ElementLength();
+    if (!ArrayRequest(env, op))
+        return env.Undefined();
+    return Napi::Number::New(env, op.count);
+}
+
+// resizeArray(name, size)
+Napi::Value PdEngine::resizeArray(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    const char *usage = "(name: string, size: number)";
+    PdRequest op{};
+    op.type = PdRequestType::ArrayResize;
+    if (!ReadArrayName(info, op, usage))
+        return env.Undefined();
+    if (info.Length() < 2 || !ReadArrayIndex(info[1], op.count) || op.count < 1)
+    {
+        Napi::TypeError::New(env, usage).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    ArrayRequest(env, op);
+    return env.Undefined();
+}
+
+#ifdef HAVE_MINIAUDIO
+// Décode un fichier entier en mono, au taux de l'engine. channel < 0 : moyenne
+// des canaux. Thread du loader, jamais le thread audio.
+static bool DecodeToMono(const std::string &path, uint32_t sampleRate, int channel, std::vector<float> &out,
+                         std::string &error)
+{
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, sampleRate);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(path.c_str(), &config, &decoder) != MA_SUCCESS)
+    {
+        error = "cannot decode " + path;
+        return false;
+    }
+    const uint32_t channels = decoder.outputChannels;
+    if (channel >= (int)channels)
+    {
+        ma_decoder_uninit(&decoder);
+        error = "channel out of range";
+        return false;
+    }
+    ma_uint64 length = 0;
+    if (ma_decoder_get_length_in_pcm_frames(&decoder, &length) == MA_SUCCESS && length > 0)
+        out.reserve((size_t)length);
+
+    const ma_uint64 blockFrames = 4096;
+    std::vector<float> block((size_t)blockFrames * channels);
+    for (;;)
+    {
+        ma_uint64 read = 0;
+        const ma_result result = ma_decoder_read_pcm_frames(&decoder, block.data(), blockFrames, &read);
+        for (ma_uint64 f = 0; f < read; ++f)
+        {
+            const float *frame = &block[(size_t)f * channels];
+            if (channel >= 0)
+                out.push_back(frame[channel]);
+            else
+            {
+                float sum = 0.0f;
+                for (uint32_t c = 0; c < channels; ++c)
+                    sum += frame[c];
+                out.push_back(sum / (float)channels);
+            }
+        }
+        if (result != MA_SUCCESS || read < blockFrames)
+            break;
+    }
+    ma_decoder_uninit(&decoder);
+    return true;
+}
+#endif
+
+// Background side of a request: the worker publishes it and waits, and its
+// progress callback lets the JS thread run it when no DSP thread does
+template <typename T>
+class PdRequestWorker : public Napi::AsyncProgressWorker<T>
+{
+public:
+    Napi::Promise Promise() const { return deferred_.Promise(); }
+
+protected:
+    using Progress = typename Napi::AsyncProgressWorker<T>::ExecutionProgress;
+
+    PdRequestWorker(Napi::Env env, const char *resource, PdEngine *engine, Napi::Object self)
+        : Napi::AsyncProgressWorker<T>(env, resource), deferred_(Napi::Promise::Deferred::New(env)), engine_(engine)
+    {
+        // Le moteur reste vivant jusqu'à la fin de la requête
+        self_ = Napi::Persistent(self);
+    }
+
+    // Worker thread: runs op wherever libpd lives; false, error set, on timeout
+    bool Run(PdRequest &op, const Progress &progress)
+    {
+        op.done = &done_;
+        if (!engine_->PostRequest(op, PdEngine::kWorkerTimeoutMs))
+        {
+            this->SetError("request timed out");
+            return false;
+        }
+        // Réveille le thread JS : sans thread DSP, c'est lui qui exécute la requête
+        progress.Signal();
+        if (!engine_->WaitRequest(op, PdEngine::kWorkerTimeoutMs))
+        {
+            this->SetError("request timed out");
+            return false;
+        }
+        return true;
+    }
+
+    // JS thread, from OnProgress
+    void ServiceRequests() { engine_->ServiceRequests(); }
+
+    Napi::Promise::Deferred deferred_;
+    PdEngine *engine_;
+    Napi::ObjectReference self_;
+    RtSemaphore done_;
+};
+
+struct ArrayLoadProgress
+{
+    uint64_t loaded;
+    uint64_t total;
+};
+
+// loadArray runs on a libuv worker: decoding (file sources), then one resize and
+// bounded chunk writes, each applied between two ticks, one per tick at most.
+// Progress reports are coalesced by N-API.
+class ArrayLoadWorker : public PdRequestWorker<ArrayLoadProgress>
+{
+public:
+    ArrayLoadWorker(Napi::Env env, PdEngine *engine, Napi::Object self, const PdRequest &op, uint32_t chunk)
+        : PdRequestWorker<ArrayLoadProgress>(env, "PdEngine.loadArray", engine, self), op_(op), chunk_(chunk)
+    {
+    }
+
+    // Float32Array source: read in place, kept alive until the promise settles
+    void SetSource(Napi::Float32Array source)
+    {
+        source_ = Napi::Persistent(static_cast<Napi::Object>(source));
+        data_ = source.Data();
+        length_ = source.ElementLength();
+    }
+
+    void SetPath(const std::string &path, int channel)
+    {
+        path_ = path;
+        channel_ = channel;
+    }
+
+    void SetProgressCallback(Napi::Function callback) { onProgress_ = Napi::Persistent(callback); }
+
+protected:
+    void Execute(const Progress &progress) override
+    {
+        if (!path_.empty())
+        {
+#ifdef HAVE_MINIAUDIO
+            std::string error;
+            if (!DecodeToMono(path_, (uint32_t)engine_->sampleRate_, channel_, samples_, error))
+            {
+                SetError(error);
+                return;
+            }
+            data_ = samples_.data();
+            length_ = samples_.size();
+#else
+            SetError("loading files needs the miniaudio backend");
+            return;
+#endif
+        }
+        if (length_ == 0 || length_ > (size_t)INT32_MAX)
+        {
+            SetError(length_ == 0 ? "source is empty" : "source too large");
+            return;
+        }
+
+        // Un seul redimensionnement, puis des blocs bornés
+        op_.type = PdRequestType::ArrayResize;
+        op_.count = (int)length_;
+        if (!RunArray(progress))
+            return;
+        op_.type = PdRequestType::ArrayWrite;
+        for (size_t pos = 0; pos < length_; pos += chunk_)
+        {
+            op_.offset = (int)pos;
+            op_.count = (int)std::min((size_t)chunk_, length_ - pos);
+            op_.data = const_cast<float *>(data_ + pos);
+            if (!RunArray(progress))
+                return;
+            engine_->arrayLoadedSamples_.fetch_add((uint64_t)op_.count, std::memory_order_relaxed);
+            const ArrayLoadProgress report{(uint64_t)(pos + op_.count), (uint64_t)length_};
+            progress.Send(&report, 1);
+        }
+    }
+
+    void OnProgress(const ArrayLoadProgress *data, size_t count) override
+    {
+        ServiceRequests();
+        if (data && count > 0 && !onProgress_.IsEmpty())
+        {
+            Napi::Env env = Env();
+            onProgress_.Call({Napi::Number::New(env, (double)data[count - 1].loaded),
+                              Napi::Number::New(env, (double)data[count - 1].total)});
+        }
+    }
+
+    void OnOK() override
+    {
+        Finish();
+        deferred_.Resolve(Napi::Number::New(Env(), (double)length_));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        Finish();
+        deferred_.Reject(error.Value());
+    }
+
+private:
+    // Run() plus libpd's array errors
+    bool RunArray(const Progress &progress)
+    {
+        if (!Run(op_, progress))
+            return false;
+        engine_->arrayOps_.fetch_add(1, std::memory_order_relaxed);
+        if (op_.result == kPdArrayNotFound)
+        {
+            SetError(std::string("array not found: ") + op_.name);
+            return false;
+        }
+        if (op_.result < 0)
+        {
+            SetError("array range out of bounds");
+            return false;
+        }
+        return true;
+    }
+
+    void Finish()
+    {
+        engine_->arrayLoads_.fetch_sub(1, std::memory_order_relaxed);
+        // Le décodage peut peser des centaines de Mo : rendu tout de suite
+        std::vector<float>().swap(samples_);
+    }
+
+    Napi::ObjectReference source_;
+    Napi::FunctionReference onProgress_;
+    PdRequest op_;
+    uint32_t chunk_;
+    const float *data_ = nullptr;
+    size_t length_ = 0;
+    std::string path_;
+    int channel_ = -1;
+    std::vector<float> samples_;
+};
+
+// loadArray(name, source: Float32Array | path, { chunkSize?, channel?, onProgress? })
+// -> Promise<number of elements>. The array is resized to the source length.
+Napi::Value PdEngine::loadArray(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    const char *usage = "(name: string, source: Float32Array | string, options?: object)";
+    PdRequest op{};
+    if (!ReadArrayName(info, op, usage))
+        return env.Undefined();
+    const bool isArray = info.Length() > 1 && info[1].IsTypedArray() &&
+                         info[1].As<Napi::TypedArray>().TypedArrayType() == napi_float32_array;
+    if (info.Length() < 2 || (!isArray && !info[1].IsString()))
+    {
+        Napi::TypeError::New(env, usage).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    uint32_t chunk = kArrayLoadChunk;
+    int channel = -1;
+    Napi::Function onProgress;
+    if (info.Length() > 2 && info[2].IsObject())
+    {
+        Napi::Object options = info[2].As<Napi::Object>();
+        if (options.Has("chunkSize"))
+        {
+            const double size = options.Get("chunkSize").ToNumber().DoubleValue();
+            chunk = size >= 64.0 && size <= (double)(1u << 24) ? (uint32_t)size : kArrayLoadChunk;
+        }
+        if (options.Has("channel"))
+            channel = options.Get("channel").ToNumber().Int32Value();
+        if (options.Has("onProgress") && options.Get("onProgress").IsFunction())
+            onProgress = options.Get("onProgress").As<Napi::Function>();
+    }
+
+    auto *worker = new ArrayLoadWorker(env, this, info.This().As<Napi::Object>(), op, chunk);
+    if (isArray)
+        worker->SetSource(info[1].As<Napi::Float32Array>());
+    else
+        worker->SetPath(info[1].As<Napi::String>().Utf8Value(), channel);
+    if (!onProgress.IsEmpty())
+        worker->SetProgressCallback(onProgress);
+    arrayLoads_.fetch_add(1, std::memory_order_relaxed);
+    worker->Queue();
+    return worker->Promise();
+}
+
+// Only looks at the header, off the main thread: missing or non-patch files fail
+// here without reaching the DSP side. libpd_openfile still reads the file itself.
+static bool CheckPatchFile(const std::string &path, std::string &error)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        error = "cannot read " + path;
+        return false;
+    }
+    char header[3];
+    const size_t n = fread(header, 1, sizeof(header), file);
+    fclose(file);
+    // "#N canvas", ou "#N struct" pour les patches à structures de données
+    if (n != sizeof(header) || std::memcmp(header, "#N ", sizeof(header)) != 0)
+    {
+        error = "not a Pd patch: " + path;
+        return false;
+    }
+    return true;
+}
+
+// openPatchAsync/closePatchAsync: the patch file is checked on a libuv worker,
+// then libpd_openfile or libpd_closefile runs on the thread that owns libpd,
+// between two ticks.
+class PatchWorker : public PdRequestWorker<char>
+{
+public:
+    PatchWorker(Napi::Env env, PdEngine *engine, Napi::Object self, const std::string &path, void *patch)
+        : PdRequestWorker<char>(env, patch ? "PdEngine.closePatchAsync" : "PdEngine.openPatchAsync", engine, self),
+          path_(path)
+    {
+        op_.type = patch ? PdRequestType::ClosePatch : PdRequestType::OpenPatch;
+        op_.patch = patch;
+        PdEngine::splitPath(path_, dir_, file_);
+        op_.dir = dir_.c_str();
+        op_.file = file_.c_str();
+    }
+
+protected:
+    void Execute(const Progress &progress) override
+    {
+        std::string error;
+        if (op_.type == PdRequestType::OpenPatch && !CheckPatchFile(path_, error))
+        {
+            SetError(error);
+            return;
+        }
+        if (!Run(op_, progress))
+            return;
+        if (op_.result < 0)
+            SetError("Failed to open patch");
+    }
+
+    void OnProgress(const char *, size_t) override { ServiceRequests(); }
+
+    void OnOK() override
+    {
+#ifdef HAVE_LIBPD
+        if (op_.type == PdRequestType::OpenPatch)
+            engine_->patch_ = op_.patch;
+#endif
+        deferred_.Resolve(Env().Undefined());
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+#ifdef HAVE_LIBPD
+        // Fermeture jamais exécutée (délai expiré) : le patch est toujours ouvert
+        if (op_.type == PdRequestType::ClosePatch && !engine_->patch_)
+            engine_->patch_ = op_.patch;
+#endif
+        deferred_.Reject(error.Value());
+    }
+
+private:
+    std::string path_;
+    std::string dir_;
+    std::string file_;
+    PdRequest op_{};
+};
+
+// openPatchAsync(path) -> Promise<void>
+Napi::Value PdEngine::openPatchAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "path string required").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (reloading_)
+    {
+        Napi::Error::New(env, "patch reload in progress").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    auto *worker = new PatchWorker(env, this, info.This().As<Napi::Object>(),
+                                   info[0].As<Napi::String>().Utf8Value(), nullptr);
+    worker->Queue();
+    return worker->Promise();
+}
+
+// closePatchAsync() -> Promise<void>
+Napi::Value PdEngine::closePatchAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (reloading_)
+    {
+        Napi::Error::New(env, "patch reload in progress").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    void *patch = nullptr;
+#ifdef HAVE_LIBPD
+    // Le handle quitte patch_ tout de suite : un second appel ne le refermera pas
+    patch = patch_;
+    patch_ = nullptr;
+#endif
+    if (!patch)
+    {
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+        deferred.Resolve(env.Undefined());
+        return deferred.Promise();
+    }
+    auto *worker = new PatchWorker(env, this, info.This().As<Napi::Object>(), std::string(), patch);
+    worker->Queue();
+    return worker->Promise();
+}
+
+// JS thread: snapshot of the listeners bound right now. Their (un)binds wait
+// for EndReload, so the spare instance gets exactly these bindings.
+void PdEngine::BeginReload(PdReload &reload)
+{
+    reloading_ = true;
+    reloadTouched_.clear();
+    for (auto &entry : listeners_)
+    {
+        if (!entry.second->callbacks.empty())
+            reload.bindings.push_back({entry.first, &entry.second->binding, nullptr});
+    }
+#ifdef HAVE_LIBPD
+    reload.oldPatch = patch_;
+#endif
+}
+
+// JS thread: replays the listener changes made during the reload against the
+// snapshot, which is what the live instance is bound to whether the swap
+// happened or not
+void PdEngine::EndReload(const PdReload &reload)
+{
+    reloading_ = false;
+    for (const std::string &name : reloadTouched_)
+    {
+        auto it = listeners_.find(name);
+        if (it == listeners_.end())
+            continue;
+        const bool wanted = !it->second->callbacks.empty();
+        bool bound = false;
+        for (const PdReload::Binding &binding : reload.bindings)
+            bound = bound || binding.name == name;
+        if (wanted == bound)
+            continue;
+        PdCommand cmd{};
+        cmd.type = wanted ? PdCommandType::Bind : PdCommandType::Unbind;
+        CopyPdName(cmd.receiver, name.data(), name.size());
+        cmd.ptr = &it->second->binding;
+        PostCommand(cmd);
+    }
+    reloadTouched_.clear();
+}
+
+// reloadPatch: the spare instance is set up and the new patch opened on a libuv
+// worker, where nothing else uses that instance. The DSP thread then swaps it in
+// between two ticks and crossfades; the worker frees the retired instance once
+// the fade is over, away from the audio thread.
+class ReloadWorker : public PdRequestWorker<char>
+{
+public:
+    ReloadWorker(Napi::Env env, PdEngine *engine, Napi::Object self, const std::string &path, uint32_t fadeFrames)
+        : PdRequestWorker<char>(env, "PdEngine.reloadPatch", engine, self), path_(path)
+    {
+        PdEngine::splitPath(path_, dir_, file_);
+        reload_.fadeFrames = fadeFrames;
+        engine_->BeginReload(reload_);
+    }
+
+protected:
+    void Execute(const Progress &progress) override
+    {
+        std::string error;
+        if (!CheckPatchFile(path_, error))
+        {
+            SetError(error);
+            return;
+        }
+#ifdef HAVE_LIBPD
+        reload_.instance = libpd_new_instance();
+        if (!reload_.instance)
+        {
+            SetError("reloadPatch needs libpd built with PDINSTANCE");
+            return;
+        }
+        libpd_set_instance(reload_.instance);
+        PdEngine::InstallHooks();
+        engine_->InitInstanceAudio();
+        for (PdReload::Binding &binding : reload_.bindings)
+            binding.handle = libpd_bind(binding.name.c_str());
+        reload_.patch = libpd_openfile(file_.c_str(), dir_.c_str());
+        if (!reload_.patch)
+        {
+            Release(nullptr);
+            SetError("Failed to open patch");
+            return;
+        }
+
+        PdRequest op{};
+        op.type = PdRequestType::SwapInstance;
+        op.context = &reload_;
+        if (!Run(op, progress))
+        {
+            // Requête retirée : l'instance de rechange n'a jamais servi
+            Release(reload_.patch);
+            return;
+        }
+        if (reload_.fading)
+            reload_.fadeDone.Wait();
+        // reload_ tient maintenant l'instance retirée et ses bindings
+        Release(reload_.oldPatch);
+#else
+        (void)progress;
+        SetError("reloadPatch needs libpd built with PDINSTANCE");
+#endif
+    }
+
+    void OnProgress(const char *, size_t) override { ServiceRequests(); }
+
+    void OnOK() override
+    {
+#ifdef HAVE_LIBPD
+        engine_->patch_ = reload_.patch;
+#endif
+        engine_->reloads_.fetch_add(1, std::memory_order_relaxed);
+        engine_->EndReload(reload_);
+        deferred_.Resolve(Env().Undefined());
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        engine_->EndReload(reload_);
+        deferred_.Reject(error.Value());
+    }
+
+private:
+#ifdef HAVE_LIBPD
+    // Worker thread: frees reload_.instance, which nothing renders anymore
+    void Release(void *patch)
+    {
+        libpd_set_instance(reload_.instance);
+        // Plus de données d'instance : ce que la fermeture envoie n'atteint pas le JS
+        libpd_set_instancedata(nullptr, nullptr);
+        for (PdReload::Binding &binding : reload_.bindings)
+        {
+            if (binding.handle)
+                libpd_unbind(binding.handle);
+            binding.handle = nullptr;
+        }
+        if (patch)
+            libpd_closefile(patch);
+        libpd_free_instance(reload_.instance);
+        reload_.instance = nullptr;
+    }
+#endif
+
+    std::string path_;
+    std::string dir_;
+    std::string file_;
+    PdReload reload_;
+};
+
+// reloadPatch(path, { crossfadeMs = 50 }) -> Promise<void>, settled once the old
+// instance is freed
+Napi::Value PdEngine::reloadPatch(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "(path: string, options?: { crossfadeMs?: number })").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (reloading_)
+    {
+        Napi::Error::New(env, "patch reload in progress").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    double crossfadeMs = 50.0;
+    if (info.Length() > 1 && info[1].IsObject() && info[1].As<Napi::Object>().Has("crossfadeMs"))
+        crossfadeMs = info[1].As<Napi::Object>().Get("crossfadeMs").ToNumber().DoubleValue();
+    if (!(crossfadeMs >= 0.0 && crossfadeMs <= 60000.0))
+    {
+        Napi::RangeError::New(env, "crossfadeMs must be between 0 and 60000").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    const uint32_t fadeFrames = (uint32_t)std::ceil(crossfadeMs * (double)sampleRate_ / 1000.0);
+    auto *worker = new ReloadWorker(env, this, info.This().As<Napi::Object>(),
+                                    info[0].As<Napi::String>().Utf8Value(), fadeFrames);
+    worker->Queue();
+    return worker->Promise();
+}
+
+// Frames rendered by Pd so far: the start of the next tick to be rendered
+Napi::Value PdEngine::getSampleTime(const Napi::CallbackInfo &info)
+{
+    return Napi::Number::New(info.Env(), (double)sampleClock_.load(std::memory_order_relaxed));
+}
+
+Napi::Value PdEngine::getLatency(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    // fifoFrames: frames déjà rendues par Pd qui attendent la période suivante (< 64)
+    const uint32_t fifoFrames = fifoFrames_.load(std::memory_order_relaxed);
+    uint32_t deviceFrames = 0;
+#ifdef HAVE_MINIAUDIO
+    if (device_)
+        deviceFrames = device_->playback.internalPeriodSizeInFrames * device_->playback.internalPeriods;
+#endif
+    const uint32_t totalFrames = deviceFrames + fifoFrames;
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("periodFrames", Napi::Number::New(env, lastPeriodFrames_.load(std::memory_order_relaxed)));
+    result.Set("fifoFrames", Napi::Number::New(env, fifoFrames));
+    result.Set("maxFifoFrames", Napi::Number::New(env, kPdBlockSize - 1));
+    result.Set("deviceFrames", Napi::Number::New(env, deviceFrames));
+    result.Set("totalFrames", Napi::Number::New(env, totalFrames));
+    result.Set("ms", Napi::Number::New(env, sampleRate_ > 0 ? (totalFrames * 1000.0) / sampleRate_ : 0.0));
+    return result;
+}
+
+Napi::Object DspStatsObject(Napi::Env env, const DspStats &stats)
+{
+    Napi::Object load = Napi::Object::New(env);
+    load.Set("min", Napi::Number::New(env, stats.loadMin));
+    load.Set("mean", Napi::Number::New(env, stats.LoadMean()));
+    load.Set("max", Napi::Number::New(env, stats.loadMax));
+    load.Set("p99", Napi::Number::New(env, stats.LoadQuantile(0.99)));
+    load.Set("last", Napi::Number::New(env, stats.lastLoad));
+
+    Napi::Object dsp = Napi::Object::New(env);
+    dsp.Set("callbacks", Napi::Number::New(env, (double)stats.callbacks));
+    dsp.Set("frames", Napi::Number::New(env, (double)stats.frames));
+    dsp.Set("lateCallbacks", Napi::Number::New(env, (double)stats.lateCallbacks));
+    dsp.Set("processErrors", Napi::Number::New(env, (double)stats.processErrors));
+    dsp.Set("budgetUs", Napi::Number::New(env, stats.lastBudgetUs));
+    dsp.Set("load", load);
+    return dsp;
+}
+
+Napi::Value PdEngine::getStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::Object commands = Napi::Object::New(env);
+    commands.Set("capacity", Napi::Number::New(env, (double)commands_.Capacity()));
+    commands.Set("pending", Napi::Number::New(env, (double)commands_.SizeApprox()));
+    commands.Set("overflows", Napi::Number::New(env, (double)commandOverflows_.load(std::memory_order_relaxed)));
+
+    Napi::Object messages = Napi::Object::New(env);
+    messages.Set("capacity", Napi::Number::New(env, (double)messages_.Capacity()));
+    messages.Set("pending", Napi::Number::New(env, (double)messages_.SizeApprox()));
+    messages.Set("drops", Napi::Number::New(env, (double)messageDrops_.load(std::memory_order_relaxed)));
+
+    Napi::Object midi = Napi::Object::New(env);
+    midi.Set("capacity", Napi::Number::New(env, (double)midiOut_.Capacity()));
+    midi.Set("pending", Napi::Number::New(env, (double)midiOut_.SizeApprox()));
+    midi.Set("drops", Napi::Number::New(env, (double)midiDrops_.load(std::memory_order_relaxed)));
+
+    Napi::Object print = Napi::Object::New(env);
+    print.Set("capacity", Napi::Number::New(env, (double)printRing_.Capacity()));
+    print.Set("drops", Napi::Number::New(env, (double)printDrops_.load(std::memory_order_relaxed)));
+    print.Set("suppressed", Napi::Number::New(env, (double)printSuppressed_.load(std::memory_order_relaxed)));
+    print.Set("coalesced", Napi::Number::New(env, (double)printCoalesced_.load(std::memory_order_relaxed)));
+
+    Napi::Object tapStats = Napi::Object::New(env);
+    PdTap *tap = tap_.load();
+    tapStats.Set("active", Napi::Boolean::New(env, tap != nullptr));
+    if (tap)
+    {
+        tapStats.Set("chunks", Napi::Number::New(env, (double)tap->delivered.load(std::memory_order_relaxed)));
+        tapStats.Set("overruns", Napi::Number::New(env, (double)tap->overruns.load(std::memory_order_relaxed)));
+        tapStats.Set("skipped", Napi::Number::New(env, (double)tap->skipped.load(std::memory_order_relaxed)));
+        tapStats.Set("buffered", Napi::Number::New(env, tap->ring.ReadableFrames()));
+    }
+
+    Napi::Object scheduled = Napi::Object::New(env);
+    scheduled.Set("capacity", Napi::Number::New(env, (double)scheduled_.Capacity()));
+    scheduled.Set("pending", Napi::Number::New(env, (double)scheduledPending_.load(std::memory_order_relaxed)));
+    scheduled.Set("drops", Napi::Number::New(env, (double)scheduledDrops_.load(std::memory_order_relaxed)));
+
+    uint32_t paramSlots = 0;
+    for (const auto &block : paramBlockStorage_)
+        paramSlots += block->count;
+    Napi::Object params = Napi::Object::New(env);
+    params.Set("blocks", Napi::Number::New(env, (double)paramBlockStorage_.size()));
+    params.Set("slots", Napi::Number::New(env, paramSlots));
+    params.Set("dispatches", Napi::Number::New(env, (double)paramDispatches_.load(std::memory_order_relaxed)));
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("commands", commands);
+    result.Set("scheduled", scheduled);
+    result.Set("params", params);
+    result.Set("arrayOps", Napi::Number::New(env, (double)arrayOps_.load(std::memory_order_relaxed)));
+    Napi::Object arrayLoads = Napi::Object::New(env);
+    arrayLoads.Set("active", Napi::Number::New(env, arrayLoads_.load(std::memory_order_relaxed)));
+    arrayLoads.Set("samples", Napi::Number::New(env, (double)arrayLoadedSamples_.load(std::memory_order_relaxed)));
+    result.Set("arrayLoads", arrayLoads);
+
+    Napi::Object graph = Napi::Object::New(env);
+    graph.Set("changes", Napi::Number::New(env, (double)graphChanges_.load(std::memory_order_relaxed)));
+    graph.Set("reloads", Napi::Number::New(env, (double)reloads_.load(std::memory_order_relaxed)));
+    graph.Set("resizes", Napi::Number::New(env, (double)arrayResizes_.load(std::memory_order_relaxed)));
+    graph.Set("lastHoldUs", Napi::Number::New(env, graphHoldLastUs_.load(std::memory_order_relaxed)));
+    graph.Set("maxHoldUs", Napi::Number::New(env, graphHoldMaxUs_.load(std::memory_order_relaxed)));
+    graph.Set("totalHoldUs", Napi::Number::New(env, (double)graphHoldTotalUs_.load(std::memory_order_relaxed)));
+    result.Set("graph", graph);
+    result.Set("messages", messages);
+    result.Set("midi", midi);
+    result.Set("print", print);
+    result.Set("tap", tapStats);
+    // Copie cohérente publiée par le thread audio, sans verrou de son côté
+    result.Set("dsp", DspStatsObject(env, dspStats_.Load()));
+    result.Set("outputKernel", Napi::String::New(env, GainKernelName()));
+    return result;
+}
+
+// getMeters() -> { windows, frames, peak, rms, truePeak? }: the last metering
+// window, per channel, in linear amplitude (20 * log10 for dBFS). Lock-free copy
+// of what the audio thread published; windows counts the windows so far.
+Napi::Value PdEngine::getMeters(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    const MeterSnapshot snap = meter_.Load();
+    Napi::Array peak = Napi::Array::New(env, snap.channels);
+    Napi::Array rms = Napi::Array::New(env, snap.channels);
+    Napi::Array truePeak = Napi::Array::New(env, snap.channels);
+    for (uint32_t ch = 0; ch < snap.channels; ++ch)
+    {
+        peak.Set(ch, Napi::Number::New(env, snap.peak[ch]));
+        rms.Set(ch, Napi::Number::New(env, snap.rms[ch]));
+        truePeak.Set(ch, Napi::Number::New(env, snap.truePeak[ch]));
+    }
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("windows", Napi::Number::New(env, (double)snap.windows));
+    result.Set("frames", Napi::Number::New(env, snap.frames));
+    result.Set("peak", peak);
+    result.Set("rms", rms);
+    if (meter_.TruePeak())
+        result.Set("truePeak", truePeak);
+    return result;
+}
+
+// attachMeterBuffer(header: Int32Array, values: Float32Array) -> channels.
+// Low-level half of engine.createMeterView() (index.js), which allocates the
+// SharedArrayBuffer. Once per engine: the buffer then lives as long as it does.
+Napi::Value PdEngine::attachMeterBuffer(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[0].IsTypedArray() || !info[1].IsTypedArray() ||
+        info[0].As<Napi::TypedArray>().TypedArrayType() != napi_int32_array ||
+        info[1].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array)
+    {
+        Napi::TypeError::New(env, "(header: Int32Array, values: Float32Array)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (meterMirror_)
+    {
+        Napi::Error::New(env, "meter buffer already attached").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Int32Array header = info[0].As<Napi::Int32Array>();
+    Napi::Float32Array values = info[1].As<Napi::Float32Array>();
+    const uint32_t channels = std::min<uint32_t>((uint32_t)channelsOut_, kMeterMaxChannels);
+    if (header.ElementLength() < 2 || values.ElementLength() < (size_t)channels * 3)
+    {
+        Napi::RangeError::New(env, "header needs 2 slots, values 3 per channel").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    meterMirror_.reset(new MeterMirror());
+    meterMirror_->seq = reinterpret_cast<std::atomic<int32_t> *>(header.Data());
+    meterMirror_->windows = reinterpret_cast<std::atomic<int32_t> *>(header.Data() + 1);
+    meterMirror_->values = reinterpret_cast<std::atomic<float> *>(values.Data());
+    meterMirror_->channels = channels;
+    meterMirrorRefs_.push_back(Napi::Persistent(static_cast<Napi::Object>(header)));
+    meterMirrorRefs_.push_back(Napi::Persistent(static_cast<Napi::Object>(values)));
+    meter_.AttachMirror(meterMirror_.get());
+    return Napi::Number::New(env, channels);
+}
+
+Napi::Value PdEngine::setGain(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "(gain: number)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    // Lu une fois par période par le thread audio, qui fait la rampe
+    targetGain_.store(info[0].As<Napi::Number>().FloatValue(), std::memory_order_relaxed);
+    return env.Undefined();
+}
+
+Napi::Value PdEngine::setClip(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsBoolean())
+    {
+        Napi::TypeError::New(env, "(enabled: boolean)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    clip_.store(info[0].As<Napi::Boolean>().Value(), std::memory_order_relaxed);
+    return env.Undefined();
+}
+
+Napi::Value PdEngine::setRenderAhead(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "(periods: number)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    SetRenderAheadPeriods(info[0].As<Napi::Number>().Int32Value());
+    return Napi::Number::New(env, renderAhead_);
+}
+
+Napi::Value PdEngine::getRenderWatermark(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("enabled", Napi::Boolean::New(env, renderThread_));
+    result.Set("aheadPeriods", Napi::Number::New(env, renderAhead_));
+    result.Set("targetFrames", Napi::Number::New(env, renderTargetFrames_.load(std::memory_order_relaxed)));
+    result.Set("capacityFrames", Napi::Number::New(env, renderRing_.CapacityFrames()));
+    const uint32_t fill = running_ && renderThread_ ? renderRing_.ReadableFrames() : 0;
+    result.Set("fillFrames", Napi::Number::New(env, fill));
+    // Plus bas niveau vu par le callback depuis l'appel précédent (remis à zéro ici)
+    uint32_t low = renderLowWater_.exchange(UINT32_MAX, std::memory_order_relaxed);
+    result.Set("lowWatermark", Napi::Number::New(env, low == UINT32_MAX ? fill : low));
+    result.Set("underruns", Napi::Number::New(env, (double)renderUnderruns_.load(std::memory_order_relaxed)));
+    return result;
+}
+
+void ParseRtThreadOptions(Napi::Object options, RtThreadOptions &rt)
+{
+    if (options.Has("schedPolicy"))
+    {
+        std::string policy = options.Get("schedPolicy").ToString().Utf8Value();
+        if (policy == "fifo")
+            rt.policy = RtSchedPolicy::Fifo;
+        else if (policy == "rr")
+            rt.policy = RtSchedPolicy::RoundRobin;
+    }
+    if (options.Has("schedPriority"))
+        rt.priority = options.Get("schedPriority").As<Napi::Number>().Int32Value();
+    if (options.Has("cpuAffinity") && options.Get("cpuAffinity").IsArray())
+    {
+        Napi::Array cpus = options.Get("cpuAffinity").As<Napi::Array>();
+        for (uint32_t i = 0; i < cpus.Length() && rt.cpuCount < kRtMaxCpus; ++i)
+            rt.cpus[rt.cpuCount++] = cpus.Get(i).As<Napi::Number>().Int32Value();
+    }
+}
+
+static Napi::Object RtStatusObject(Napi::Env env, int status)
+{
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("requested", Napi::Boolean::New(env, status != kRtNotRequested));
+    result.Set("ok", Napi::Boolean::New(env, status == 0));
+    if (status > 0)
+        result.Set("error", Napi::String::New(env, std::strerror(status)));
+    return result;
+}
+
+Napi::Object RtThreadObject(Napi::Env env, const RtThreadStatus &status)
+{
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("applied", Napi::Boolean::New(env, status.applied.load(std::memory_order_acquire)));
+    result.Set("sched", RtStatusObject(env, status.sched.load(std::memory_order_relaxed)));
+    result.Set("affinity", RtStatusObject(env, status.affinity.load(std::memory_order_relaxed)));
+    return result;
+}
+
+// Les threads appliquent leurs réglages au démarrage : "applied" passe à true
+// après le premier callback (thread audio) ou au lancement du thread de rendu
+Napi::Value PdEngine::getRealtimeStatus(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("memoryLock", RtStatusObject(env, memoryLockStatus_));
+    result.Set("audioThread", RtThreadObject(env, audioThreadStatus_));
+    if (renderThread_)
+        result.Set("renderThread", RtThreadObject(env, renderThreadStatus_));
+    return result;
+}
+
+// tap({ frames?, channels?, policy?, chunks? }, callback) -> this.
+// callback(chunk: Float32Array, dropped: number): frames * channels interleaved
+// samples of the output after gain and clip, and how many frames were lost just
+// before it. chunk belongs to a pool and is refilled once the callback returns:
+// copy what must outlive the call.
+Napi::Value PdEngine::tap(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsFunction())
+    {
+        Napi::TypeError::New(env, "({ frames?: number, channels?: number, policy?: 'drop' | 'block', chunks?: number }, "
+                                  "callback: function)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (tap_.load())
+    {
+        Napi::Error::New(env, "output tap already open, call untap() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    double frames = 1024;
+    double channels = channelsOut_;
+    double chunks = 4;
+    std::string policy = "drop";
+    if (options.Has("frames"))
+        frames = options.Get("frames").ToNumber().DoubleValue();
+    if (options.Has("channels"))
+        channels = options.Get("channels").ToNumber().DoubleValue();
+    if (options.Has("chunks"))
+        chunks = options.Get("chunks").ToNumber().DoubleValue();
+    if (options.Has("policy"))
+        policy = options.Get("policy").ToString().Utf8Value();
+    if (!(frames >= 1 && frames <= 1 << 20) || !(channels >= 1 && channels <= channelsOut_) ||
+        !(chunks >= 1 && chunks <= 64))
+    {
+        Napi::RangeError::New(env, "frames must be 1-1048576, channels 1-channelsOut, chunks 1-64")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (policy != "drop" && policy != "block")
+    {
+        Napi::RangeError::New(env, "policy must be 'drop' or 'block'").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::unique_ptr<PdTap> tap(new PdTap());
+    tap->frames = (uint32_t)frames;
+    tap->channels = (uint32_t)channels;
+    tap->block = policy == "block";
+    // Quatre chunks d'avance, et de quoi absorber plusieurs périodes même longues
+    tap->ring.Allocate(tap->channels, std::max<uint32_t>(4 * tap->frames, 16384));
+    for (uint32_t i = 0; i < (uint32_t)chunks; ++i)
+    {
+        Napi::Float32Array chunk = Napi::Float32Array::New(env, (size_t)tap->frames * tap->channels);
+        tap->chunks.push_back(chunk.Data());
+        tap->chunkRefs.push_back(Napi::Persistent(static_cast<Napi::Object>(chunk)));
+        tap->freeSem.Post();
+    }
+    tap->tsfn = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "PdEngine.tap", 0, 1);
+    tap->tsfn.Unref(env);
+    PdTap *raw = tap.release();
+    raw->thread = std::thread([raw]()
+                              { raw->Run(); });
+    tap_.store(raw);
+    return info.This();
+}
+
+Napi::Value PdEngine::untap(const Napi::CallbackInfo &info)
+{
+    CloseTap();
+    return info.This();
+}
+
+Napi::Value PdEngine::on(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsFunction())
+    {
+        Napi::TypeError::New(env, "(receiver: string, callback: function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    if (name.size() >= kPdMaxNameLength)
+    {
+        Napi::RangeError::New(env, "receiver name too long").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    StartNotifier(env);
+
+    std::unique_ptr<Listener> &entry = listeners_[name];
+    if (!entry)
+        entry.reset(new Listener());
+    if (entry->callbacks.empty() && reloading_)
+        reloadTouched_.push_back(name);
+    else if (entry->callbacks.empty())
+    {
+        // Premier listener : libpd_bind côté DSP, dans l'ordre des autres commandes
+        PdCommand cmd{};
+        cmd.type = PdCommandType::Bind;
+        CopyPdName(cmd.receiver, name.data(), name.size());
+        cmd.ptr = &entry->binding;
+        if (!PostCommand(cmd))
+        {
+            Napi::Error::New(env, "command queue full").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    entry->callbacks.push_back(Napi::Persistent(info[1].As<Napi::Function>()));
+    return info.This();
+}
+
+Napi::Value PdEngine::off(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "(receiver: string, callback?: function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    auto it = listeners_.find(name);
+    if (it == listeners_.end() || it->second->callbacks.empty())
+        return info.This();
+
+    Listener &entry = *it->second;
+    if (info.Length() > 1 && info[1].IsFunction())
+    {
+        Napi::Function fn = info[1].As<Napi::Function>();
+        for (auto cb = entry.callbacks.begin(); cb != entry.callbacks.end(); ++cb)
+        {
+            if (cb->Value().StrictEquals(fn))
+            {
+                entry.callbacks.erase(cb);
+                break;
+            }
+        }
+    }
+    else
+    {
+        entry.callbacks.clear();
+    }
+
+    if (entry.callbacks.empty() && reloading_)
+        reloadTouched_.push_back(it->first);
+    else if (entry.callbacks.empty())
+    {
+        // L'entrée reste dans la map : son slot de binding est encore référencé
+        // par la commande jusqu'à ce que le thread DSP l'ait traitée
+        PdCommand cmd{};
+        cmd.type = PdCommandType::Unbind;
+        CopyPdName(cmd.receiver, it->first.data(), it->first.size());
+        cmd.ptr = &entry.binding;
+        if (!PostCommand(cmd))
+        {
+            Napi::Error::New(env, "command queue full").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    return info.This();
+}
+
+// onMidi(callback): callback(events: Uint8Array, times: Float64Array) with
+// everything Pd sent to its MIDI outputs since the last call, 4 bytes per event
+// (status, data1, data2, port) and the sample time of each
+Napi::Value PdEngine::onMidi(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "(callback: function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    StartNotifier(env);
+    midiCallbacks_.push_back(Napi::Persistent(info[0].As<Napi::Function>()));
+    midiListening_.store(true, std::memory_order_relaxed);
+    return info.This();
+}
+
+Napi::Value PdEngine::offMidi(const Napi::CallbackInfo &info)
+{
+    if (info.Length() > 0 && info[0].IsFunction())
+    {
+        Napi::Function fn = info[0].As<Napi::Function>();
+        for (auto cb = midiCallbacks_.begin(); cb != midiCallbacks_.end(); ++cb)
+        {
+            if (cb->Value().StrictEquals(fn))
+            {
+                midiCallbacks_.erase(cb);
+                break;
+            }
+        }
+    }
+    else
+    {
+        midiCallbacks_.clear();
+    }
+    // Ce qui est encore en file sera jeté par DeliverMidi
+    if (midiCallbacks_.empty())
+        midiListening_.store(false, std::memory_order_relaxed);
+    return info.This();
+}
+
+// onPrint(callback): callback(line, count) for each line of the Pd console
+// ([print], errors); count > 1 when the line was repeated that many times
+Napi::Value PdEngine::onPrint(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "(callback: function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    StartNotifier(env);
+    StartPrintDrain();
+    printCallbacks_.push_back(Napi::Persistent(info[0].As<Napi::Function>()));
+    printListening_.store(true, std::memory_order_relaxed);
+    return info.This();
+}
+
+Napi::Value PdEngine::offPrint(const Napi::CallbackInfo &info)
+{
+    if (info.Length() > 0 && info[0].IsFunction())
+    {
+        Napi::Function fn = info[0].As<Napi::Function>();
+        for (auto cb = printCallbacks_.begin(); cb != printCallbacks_.end(); ++cb)
+        {
+            if (cb->Value().StrictEquals(fn))
+            {
+                printCallbacks_.erase(cb);
+                break;
+            }
+        }
+    }
+    else
+    {
+        printCallbacks_.clear();
+    }
+    // Ce qui est encore en file sera jeté par DeliverPrint
+    if (printCallbacks_.empty())
+        printListening_.store(false, std::memory_order_relaxed);
+    return info.This();
+}
+
+void PdEngine::StartNotifier(Napi::Env env)
+{
+    if (notifyThread_.joinable())
+        return;
+    tsfn_ = Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}),
+                                          "PdEngine.messages", 0, 1);
+    // Les listeners ne doivent pas empêcher le process Node de se terminer
+    tsfn_.Unref(env);
+    notifyStop_.store(false, std::memory_order_relaxed);
+    notifyThread_ = std::thread([this]()
+                                {
+        for (;;)
+        {
+            notifySem_.Wait();
+            if (notifyStop_.load(std::memory_order_acquire))
+                break;
+            // Un seul appel en vol : DeliverMessages vide tout ce qui est arrivé entre-temps
+            tsfn_.BlockingCall([this](Napi::Env env, Napi::Function)
+                               {
+                if (env != nullptr)
+                    DeliverMessages(env); });
+        } });
+}
+
+void PdEngine::StopNotifier()
+{
+    if (!notifyThread_.joinable())
+        return;
+    notifyStop_.store(true, std::memory_order_release);
+    notifySem_.Post();
+    notifyThread_.join();
+    // Les appels encore en file ne doivent plus atteindre cet objet
+    tsfn_.Abort();
+}
+
+void PdEngine::StartPrintDrain()
+{
+    if (printThread_.joinable())
+        return;
+    printStop_.store(false, std::memory_order_relaxed);
+    printThread_ = std::thread([this]()
+                               { PrintDrainMain(); });
+}
+
+void PdEngine::StopPrintDrain()
+{
+    if (!printThread_.joinable())
+        return;
+    printStop_.store(true, std::memory_order_release);
+    printSem_.Post();
+    printThread_.join();
+}
+
+// Print drain thread. The DSP side never signals it: it polls printRing_ every
+// kPrintDrainMs. A run of identical lines goes out once, then as (line, count)
+// when another line arrives, when the run pauses for a drain period, or at least
+// once a second while it lasts.
+void PdEngine::PrintDrainMain()
+{
+    using Clock = std::chrono::steady_clock;
+    std::string last;
+    uint32_t repeats = 0;
+    Clock::time_point repeatsSince = Clock::now();
+    double tokens = printRate_;
+    Clock::time_point refill = Clock::now();
+    char line[kPrintLineMax];
+    char record[sizeof(uint32_t) + kPrintLineMax];
+
+    auto emit = [&](const char *text, size_t length, uint32_t count)
+    {
+        std::memcpy(record, &count, sizeof(count));
+        std::memcpy(record + sizeof(count), text, length);
+        if (!printOut_.Push(record, sizeof(count) + length))
+            printDrops_.fetch_add(count, std::memory_order_relaxed);
+    };
+    auto flushRepeats = [&]()
+    {
+        if (repeats == 0)
+            return;
+        emit(last.data(), last.size(), repeats);
+        repeats = 0;
+    };
+
+    while (!printStop_.load(std::memory_order_acquire))
+    {
+        printSem_.WaitFor(kPrintDrainMs);
+        const Clock::time_point now = Clock::now();
+        if (printRate_ > 0)
+        {
+            tokens += printRate_ * std::chrono::duration<double>(now - refill).count();
+            if (tokens > printRate_)
+                tokens = printRate_;
+        }
+        refill = now;
+
+        const size_t before = printOut_.UsedBytes();
+        bool received = false;
+        size_t length;
+        while (printRing_.Pop(line, sizeof(line), length))
+        {
+            received = true;
+            if (length > sizeof(line))
+                length = sizeof(line);
+            if (length == last.size() && std::memcmp(line, last.data(), length) == 0)
+            {
+                if (repeats++ == 0)
+                    repeatsSince = now;
+                printCoalesced_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            flushRepeats();
+            last.assign(line, length);
+            if (printRate_ > 0 && tokens < 1.0)
+            {
+                printSuppressed_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            tokens -= 1.0;
+            emit(line, length, 1);
+        }
+        if (repeats > 0 && (!received || now - repeatsSince >= std::chrono::seconds(1)))
+        {
+            flushRepeats();
+            repeatsSince = now;
+        }
+
+        if (printOut_.UsedBytes() != before && !notifyPending_.exchange(true, std::memory_order_acq_rel))
+            notifySem_.Post();
+    }
+}
+
+// Audio thread (ou thread JS quand le device est arrêté)
+PdMessage *PdEngine::BeginMessage(PdMessageType type, const char *recv)
+{
+    PdMessage *m = messages_.BeginPush();
+    if (!m)
+    {
+        messageDrops_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    m->type = type;
+    m->argc = 0;
+    m->size = 0;
+    m->value = 0.0f;
+    m->symbol[0] = '\0';
+    CopyPdNameTruncated(m->receiver, recv);
+    return m;
+}
+
+void PdEngine::CommitMessage()
+{
+    messages_.CommitPush();
+    // Réveille le notifier seulement si aucune livraison n'est déjà prévue
+    if (!notifyPending_.exchange(true, std::memory_order_acq_rel))
+        notifySem_.Post();
+}
+
+// Event-loop thread, once per turn
+void PdEngine::DeliverMessages(Napi::Env env)
+{
+    notifyPending_.store(false, std::memory_order_release);
+    Napi::HandleScope scope(env);
+    if (!DeliverMidi(env) || !DeliverPrint(env))
+        return;
+
+    // Seulement ce qui est en file maintenant : le reste attend le tour suivant
+    size_t count = messages_.SizeApprox();
+    for (; count > 0; --count)
+    {
+        const PdMessage *m = messages_.Front();
+        if (!m)
+            break;
+        auto it = listeners_.find(m->receiver);
+        if (it != listeners_.end() && !it->second->callbacks.empty())
+        {
+            std::vector<napi_value> args;
+            switch (m->type)
+            {
+            case PdMessageType::Bang:
+                break;
+            case PdMessageType::Float:
+                args.push_back(Napi::Number::New(env, m->value));
+                break;
+            case PdMessageType::Symbol:
+                args.push_back(Napi::String::New(env, m->symbol));
+                break;
+            case PdMessageType::Message:
+                args.push_back(Napi::String::New(env, m->symbol));
+                // fallthrough
+            case PdMessageType::List:
+            {
+                Napi::Array list = Napi::Array::New(env, m->argc);
+                PdAtomReader reader(m->payload, m->size);
+                PdAtomView atom;
+                for (uint32_t i = 0; reader.Next(atom); ++i)
+                {
+                    if (atom.isSymbol)
+                        list.Set(i, Napi::String::New(env, atom.s));
+                    else
+                        list.Set(i, Napi::Number::New(env, atom.f));
+                }
+                args.push_back(list);
+                break;
+            }
+            }
+
+            // Copie : un callback peut appeler off() et modifier la liste
+            std::vector<Napi::Function> callbacks;
+            for (auto &ref : it->second->callbacks)
+                callbacks.push_back(ref.Value());
+            for (auto &cb : callbacks)
+            {
+                cb.Call(args);
+                if (env.IsExceptionPending())
+                {
+                    // L'exception remonte à Node ; le reste sera livré au tour suivant
+                    messages_.Pop();
+                    if (messages_.SizeApprox() > 0 && !notifyPending_.exchange(true, std::memory_order_acq_rel))
+                        notifySem_.Post();
+                    return;
+                }
+            }
+        }
+        messages_.Pop();
+    }
+}
+
+// Event-loop thread: one call per callback for everything pending in midiOut_.
+// false if a callback threw, the exception then goes up to Node.
+bool PdEngine::DeliverMidi(Napi::Env env)
+{
+    size_t count = midiOut_.SizeApprox();
+    if (count == 0)
+        return true;
+    if (midiCallbacks_.empty())
+    {
+        // Plus de listener depuis que ces événements ont été produits
+        for (; count > 0; --count)
+            midiOut_.Pop();
+        return true;
+    }
+
+    Napi::Uint8Array events = Napi::Uint8Array::New(env, count * 4);
+    Napi::Float64Array times = Napi::Float64Array::New(env, count);
+    uint8_t *e = events.Data();
+    double *t = times.Data();
+    for (size_t i = 0; i < count; ++i, e += 4)
+    {
+        const PdMidiEvent *m = midiOut_.Front();
+        e[0] = m->status;
+        e[1] = m->data1;
+        e[2] = m->data2;
+        e[3] = m->port;
+        t[i] = (double)m->time;
+        midiOut_.Pop();
+    }
+
+    // Copie : un callback peut appeler offMidi()
+    std::vector<Napi::Function> callbacks;
+    for (auto &ref : midiCallbacks_)
+        callbacks.push_back(ref.Value());
+    for (auto &cb : callbacks)
+    {
+        cb.Call({events, times});
+        if (env.IsExceptionPending())
+        {
+            if ((messages_.SizeApprox() > 0 || midiOut_.SizeApprox() > 0 || printOut_.UsedBytes() > 0) &&
+                !notifyPending_.exchange(true, std::memory_order_acq_rel))
+                notifySem_.Post();
+            return false;
+        }
+    }
+    return true;
+}
+
+// DSP side (libpd MIDI hooks)
+void PdEngine::PushMidi(uint8_t status, int data1, int data2, int port)
+{
+    if (!midiListening_.load(std::memory_order_relaxed))
+        return;
+    PdMidiEvent *e = midiOut_.BeginPush();
+    if (!e)
+    {
+        midiDrops_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    e->time = sampleTime_;
+    e->status = status;
+    e->data1 = (uint8_t)data1;
+    e->data2 = (uint8_t)data2;
+    e->port = (uint8_t)port;
+    midiOut_.CommitPush();
+    if (!notifyPending_.exchange(true, std::memory_order_acq_rel))
+        notifySem_.Post();
+}
+
+// DSP side: Pd hands over text in pieces; whole lines go to printRing_, cut at
+// kPrintLineMax bytes
+void PdEngine::PushPrint(const char *s)
+{
+    if (!printListening_.load(std::memory_order_relaxed))
+        return;
+    for (; *s != '\0'; ++s)
+    {
+        if (*s == '\n')
+        {
+            if (!printRing_.Push(printLine_, printLineLength_))
+                printDrops_.fetch_add(1, std::memory_order_relaxed);
+            printLineLength_ = 0;
+        }
+        else if (printLineLength_ < kPrintLineMax)
+        {
+            printLine_[printLineLength_++] = *s;
+        }
+    }
+}
+
+// Event-loop thread: callback(line, count) for each line waiting in printOut_;
+// count > 1 when the line was printed that many times in a row
+bool PdEngine::DeliverPrint(Napi::Env env)
+{
+    char record[sizeof(uint32_t) + kPrintLineMax];
+    size_t length;
+    while (printOut_.Pop(record, sizeof(record), length))
+    {
+        if (printCallbacks_.empty() || length < sizeof(uint32_t))
+            continue;
+        uint32_t count;
+        std::memcpy(&count, record, sizeof(count));
+        Napi::String line = Napi::String::New(env, record + sizeof(count), length - sizeof(count));
+        Napi::Number repeats = Napi::Number::New(env, count);
+
+        std::vector<Napi::Function> callbacks;
+        for (auto &ref : printCallbacks_)
+            callbacks.push_back(ref.Value());
+        for (auto &cb : callbacks)
+        {
+            cb.Call({line, repeats});
+            if (env.IsExceptionPending())
+            {
+                if ((messages_.SizeApprox() > 0 || printOut_.UsedBytes() > 0) &&
+                    !notifyPending_.exchange(true, std::memory_order_acq_rel))
+                    notifySem_.Post();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+#ifdef HAVE_LIBPD
+static void EncodeAtoms(PdMessage &m, int argc, t_atom *argv)
+{
+    PdAtomWriter writer(m.payload, sizeof(m.payload));
+    t_atom *a = argv;
+    for (int i = 0; i < argc; ++i, a = libpd_next_atom(a))
+    {
+        bool ok = true;
+        if (libpd_is_float(a))
+            ok = writer.AddFloat(libpd_get_float(a));
+        else if (libpd_is_symbol(a))
+            ok = writer.AddSymbol(libpd_get_symbol(a));
+        if (!ok)
+            break; // tronqué : la liste ne tient pas dans un enregistrement
+    }
+    m.argc = writer.Count();
+    m.size = (uint16_t)writer.Size();
+}
+#endif
+
+void PdEngine::PdBangHook(const char *recv)
+{
+#ifdef HAVE_LIBPD
+    auto *self = static_cast<PdEngine *>(libpd_get_instancedata());
+    if (self && self->BeginMessage(PdMessageType::Bang, recv))
+        self->CommitMessage();
+#else
+    (void)recv;
+#endif
+}
+
+void PdEngine::PdFloatHook(const char *recv, float x)
+{
+#ifdef HAVE_LIBPD
+    auto *self = static_cast<PdEngine *>(libpd_get_instancedata());
+    if (!self)
+        return;
+    if (PdMessage *m = self->BeginMessage(PdMessageType::Float, recv))
+    {
+        m->value = x;
+        self->CommitMessage();
+    }
+#else
+    (void)recv;
+    (void)x;
+#endif
+}
+
+void PdEngine::PdSymbolHook(const char *recv, const char *sym)
+{
+#ifdef HAVE_LIBPD
+    auto *self = static_cast<PdEngine *>(libpd_get_instancedata());
+    if (!self)
+        return;
+    if (PdMessage *m = self->BeginMessage(PdMessageType::Symbol, recv))
+    {
+        CopyPdNameTruncated(m->symbol, sym);
+        self->CommitMessage();
+    }
+#else
+    (void)recv;
+    (void)sym;
+#endif
+}
+
+void PdEngine::PdListHook(const char *recv, int argc, struct _atom *argv)
+{
+#ifdef HAVE_LIBPD
+    auto *self = static_cast<PdEngine *>(libpd_get_instancedata());
+    if (!self)
+        return;
+    if (PdMessage *m = self->BeginMessage(PdMessageType::List, recv))
+    {
+        EncodeAtoms(*m, argc, argv);
+        self->CommitMessage();
+    }
+#else
+    (void)recv;
+    (void)argc;
+    (void)argv;
+#endif
+}
+
+void PdEngine::PdMessageHook(const char *recv, const char *msg, int argc, struct _atom *argv)
+{
+#ifdef HAVE_LIBPD
+    auto *self = static_cast<PdEngine *>(libpd_get_instancedata());
+    if (!self)
+        return;
+    if (PdMessage *m = self->BeginMessage(PdMessageType::Message, recv))
+    {
+        CopyPdNameTruncated(m->symbol, msg);
+        EncodeAtoms(*m, argc, argv);
+        self->CommitMessage();
+    }
+#else
+    (void)recv;
+    (void)msg;
+    (void)argc;
+    (void)argv;
+#endif
+}
+
+void PdEngine::PdPrintHook(const char *s)
+{
+#ifdef HAVE_LIBPD
+    auto *self = static_cast<PdEngine *>(libpd_get_instancedata());
+    if (self)
+        self->PushPrint(s);
+#else
+    (void)s;
+#endif
+}
+
+// Canal libpd -> statut (canal 0-15) + port, données ramenées sur 7 bits
+void PdEngine::PushChannelMessage(uint8_t kind, int channel, int data1, int data2)
+{
+#ifdef HAVE_LIBPD
+    auto *self = static_cast<PdEngine *>(libpd_get_instancedata());
+    if (self)
+        self->PushMidi((uint8_t)(kind | (channel & 0x0F)), data1 & 0x7F, data2 & 0x7F, (channel >> 4) & 0xFF);
+#else
+    (void)kind;
+    (void)channel;
+    (void)data1;
+    (void)data2;
+#endif
+}
+
+void PdEngine::PdNoteOnHook(int channel, int pitch, int velocity)
+{
+#ifdef HAVE_LIBPD
+    PushChannelMessage(0x90, channel, pitch, velocity);
+#else
+    (void)channel;
+    (void)pitch;
+    (void)velocity;
+#endif
+}
+
+void PdEngine::PdControlChangeHook(int channel, int controller, int value)
+{
+#ifdef HAVE_LIBPD
+    PushChannelMessage(0xB0, channel, controller, value);
+#else
+    (void)channel;
+    (void)controller;
+    (void)value;
+#endif
+}
+
+void PdEngine::PdProgramChangeHook(int channel, int value)
+{
+#ifdef HAVE_LIBPD
+    PushChannelMessage(0xC0, channel, value, 0);
+#else
+    (void)channel;
+    (void)value;
+#endif
+}
+
+// value: -8192..8191, remis en 14 bits LSB/MSB comme sur le fil
+void PdEngine::PdPitchBendHook(int channel, int value)
+{
+#ifdef HAVE_LIBPD
+    const int bend = std::min(std::max(value + 8192, 0), 16383);
+    PushChannelMessage(0xE0, channel, bend & 0x7F, bend >> 7);
+#else
+    (void)channel;
+    (void)value;
+#endif
+}
+
+void PdEngine::PdAftertouchHook(int channel, int value)
+{
+#ifdef HAVE_LIBPD
+    PushChannelMessage(0xD0, channel, value, 0);
+#else
+    (void)channel;
+    (void)value;
+#endif
+}
+
+void PdEngine::PdPolyAftertouchHook(int channel, int pitch, int value)
+{
+#ifdef HAVE_LIBPD
+    PushChannelMessage(0xA0, channel, pitch, value);
+#else
+    (void)channel;
+    (void)pitch;
+    (void)value;
+#endif
+}
+
+// [midiout] : octet brut, signalé par un statut 0
+void PdEngine::PdMidiByteHook(int port, int byte)
+{
+#ifdef HAVE_LIBPD
+    auto *self = static_cast<PdEngine *>(libpd_get_instancedata());
+    if (self)
+        self->PushMidi(0, byte & 0xFF, 0, port & 0xFF);
+#else
+    (void)port;
+    (void)byte;
 #endif
-    return env.Undefined();
 }
 
 void PdEngine::splitPath(const std::string &full, std::string &dir, std::string &name)
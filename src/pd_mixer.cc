@@ -0,0 +1,444 @@
+#include "pd_mixer.h"
+#include "denormals.h"
+#include "pd_engine.h"
+#include "rt_alloc_guard.h"
+#include "rt_thread.h"
+#include "simd_gain.h"
+#include <chrono>
+#include <cstring>
+
+#ifdef HAVE_MINIAUDIO
+#include "miniaudio.h"
+#endif
+
+Napi::Object PdMixer::Init(Napi::Env env, Napi::Object exports)
+{
+    Napi::Function func = DefineClass(env, "PdMixer",
+                                      {PdMixer::InstanceMethod("add", &PdMixer::add),
+                                       PdMixer::InstanceMethod("remove", &PdMixer::remove),
+                                       PdMixer::InstanceMethod("start", &PdMixer::start),
+                                       PdMixer::InstanceMethod("stop", &PdMixer::stop),
+                                       PdMixer::InstanceMethod("setClip", &PdMixer::setClip),
+                                       PdMixer::InstanceMethod("getStats", &PdMixer::getStats)});
+
+    exports.Set("PdMixer", func);
+    return exports;
+}
+
+PdMixer::PdMixer(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<PdMixer>(info)
+{
+    // Options: { sampleRate?: number, blockSize?: number, channelsOut?: number,
+    //            workers?: number, clip?: boolean, denormalProtection?: boolean,
+    //            schedPolicy?: 'fifo' | 'rr', schedPriority?: number, cpuAffinity?: number[] }
+    // workers: threads en plus du thread audio, par défaut un par cœur restant
+    const unsigned cores = std::thread::hardware_concurrency();
+    workerCount_ = cores > 1 ? (int)cores - 1 : 0;
+    if (info.Length() > 0 && info[0].IsObject())
+    {
+        Napi::Object obj = info[0].As<Napi::Object>();
+        if (obj.Has("sampleRate"))
+            sampleRate_ = obj.Get("sampleRate").ToNumber().Int32Value();
+        if (obj.Has("blockSize"))
+            blockSize_ = obj.Get("blockSize").ToNumber().Int32Value();
+        if (obj.Has("channelsOut"))
+            channelsOut_ = obj.Get("channelsOut").ToNumber().Int32Value();
+        if (obj.Has("workers"))
+            workerCount_ = obj.Get("workers").ToNumber().Int32Value();
+        if (obj.Has("clip"))
+            clip_.store(obj.Get("clip").ToBoolean().Value(), std::memory_order_relaxed);
+        if (obj.Has("denormalProtection"))
+            denormalProtection_ = obj.Get("denormalProtection").ToBoolean().Value();
+        ParseRtThreadOptions(obj, rtOptions_);
+    }
+    if (blockSize_ < 1)
+        blockSize_ = 64;
+    if (workerCount_ < 0)
+        workerCount_ = 0;
+    if (workerCount_ > kMaxWorkers)
+        workerCount_ = kMaxWorkers;
+    slices_.reset(new Slice[(size_t)workerCount_ + 1]);
+}
+
+PdMixer::~PdMixer()
+{
+    if (running_)
+        StopInternal();
+    for (auto &slot : slots_)
+        slot->engine->DetachMixer();
+}
+
+Napi::Value PdMixer::add(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !PdEngine::IsInstance(env, info[0]))
+    {
+        Napi::TypeError::New(env, "(engine: PdEngine)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (running_)
+    {
+        Napi::Error::New(env, "stop the mixer before adding engines").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object obj = info[0].As<Napi::Object>();
+    PdEngine *engine = PdEngine::Unwrap(obj);
+    if (!engine)
+        return env.Null();
+    if (engine->sampleRate_ != sampleRate_ || engine->channelsOut_ != channelsOut_)
+    {
+        Napi::Error::New(env, "engine sampleRate and channelsOut must match the mixer").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!engine->AttachMixer(env, kMaxChunkFrames))
+        return env.Null();
+
+    std::unique_ptr<Slot> slot(new Slot());
+    slot->engine = engine;
+    slot->ref = Napi::Persistent(obj);
+    slots_.push_back(std::move(slot));
+    // Tables de la période dimensionnées ici, jamais dans le callback
+    order_.resize(slots_.size());
+    tasks_.resize(slots_.size());
+    return info.This();
+}
+
+Napi::Value PdMixer::remove(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !PdEngine::IsInstance(env, info[0]))
+    {
+        Napi::TypeError::New(env, "(engine: PdEngine)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (running_)
+    {
+        Napi::Error::New(env, "stop the mixer before removing engines").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    PdEngine *engine = PdEngine::Unwrap(info[0].As<Napi::Object>());
+    for (auto it = slots_.begin(); it != slots_.end(); ++it)
+    {
+        if ((*it)->engine == engine)
+        {
+            engine->DetachMixer();
+            slots_.erase(it);
+            break;
+        }
+    }
+    order_.resize(slots_.size());
+    tasks_.resize(slots_.size());
+    return info.This();
+}
+
+Napi::Value PdMixer::start(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (running_)
+        return env.Undefined();
+#ifdef HAVE_MINIAUDIO
+    for (auto &slot : slots_)
+        slot->engine->SetMixerRunning(true);
+    dspMeter_.Reset();
+    dspStats_.Store(dspMeter_.Stats());
+    rtSetupPending_ = true;
+    StartWorkers();
+
+    ma_device_config config = ma_device_config_init(ma_device_type_playback);
+    config.playback.format = ma_format_f32;
+    config.playback.channels = (ma_uint32)channelsOut_;
+    config.sampleRate = (ma_uint32)sampleRate_;
+    config.periodSizeInFrames = (ma_uint32)blockSize_;
+    config.noFixedSizedCallback = MA_TRUE;
+    config.pUserData = this;
+    config.dataCallback = [](ma_device *pDevice, void *pOutput, const void *, ma_uint32 frameCount)
+    {
+        auto *self = static_cast<PdMixer *>(pDevice->pUserData);
+        if (self->rtSetupPending_)
+        {
+            self->rtSetupPending_ = false;
+            ApplyRtThreadOptions(self->rtOptions_, self->deviceThreadStatus_);
+        }
+        self->dspMeter_.Begin();
+        {
+            ScopedDenormalGuard denormals(self->denormalProtection_);
+            self->AudioCallback(static_cast<float *>(pOutput), frameCount);
+        }
+        uint64_t errors = 0;
+        for (auto &slot : self->slots_)
+            errors += slot->engine->processErrors_.load(std::memory_order_relaxed);
+        self->dspMeter_.End(frameCount, self->sampleRate_, errors);
+        self->dspStats_.Store(self->dspMeter_.Stats());
+    };
+
+    if (!device_)
+        device_.reset(new ma_device());
+    if (ma_device_init(nullptr, &config, device_.get()) != MA_SUCCESS)
+    {
+        StopWorkers();
+        for (auto &slot : slots_)
+            slot->engine->SetMixerRunning(false);
+        Napi::Error::New(env, "Failed to init audio device").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (ma_device_start(device_.get()) != MA_SUCCESS)
+    {
+        ma_device_uninit(device_.get());
+        StopWorkers();
+        for (auto &slot : slots_)
+            slot->engine->SetMixerRunning(false);
+        Napi::Error::New(env, "Failed to start audio device").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    running_ = true;
+#else
+    Napi::Error::New(env, "PdMixer needs the miniaudio backend").ThrowAsJavaScriptException();
+#endif
+    return env.Undefined();
+}
+
+Napi::Value PdMixer::stop(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (running_)
+        StopInternal();
+    return env.Undefined();
+}
+
+void PdMixer::StopInternal()
+{
+#ifdef HAVE_MINIAUDIO
+    ma_device_stop(device_.get());
+    ma_device_uninit(device_.get());
+#endif
+    StopWorkers();
+    for (auto &slot : slots_)
+        slot->engine->SetMixerRunning(false);
+    running_ = false;
+}
+
+Napi::Value PdMixer::setClip(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsBoolean())
+    {
+        Napi::TypeError::New(env, "(enabled: boolean)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    clip_.store(info[0].As<Napi::Boolean>().Value(), std::memory_order_relaxed);
+    return env.Undefined();
+}
+
+Napi::Value PdMixer::getStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::Array instances = Napi::Array::New(env, slots_.size());
+    for (size_t i = 0; i < slots_.size(); ++i)
+    {
+        const Slot &slot = *slots_[i];
+        Napi::Object cost = Napi::Object::New(env);
+        cost.Set("lastUs", Napi::Number::New(env, slot.lastUs.load(std::memory_order_relaxed)));
+        cost.Set("avgUs", Napi::Number::New(env, slot.meanUs.load(std::memory_order_relaxed)));
+        cost.Set("maxUs", Napi::Number::New(env, slot.maxUs.load(std::memory_order_relaxed)));
+        cost.Set("renders", Napi::Number::New(env, (double)slot.renders.load(std::memory_order_relaxed)));
+        cost.Set("engine", slot.ref.Value());
+        instances.Set((uint32_t)i, cost);
+    }
+
+    Napi::Object periods = Napi::Object::New(env);
+    periods.Set("parallel", Napi::Number::New(env, (double)parallelPeriods_.load(std::memory_order_relaxed)));
+    periods.Set("inline", Napi::Number::New(env, (double)inlinePeriods_.load(std::memory_order_relaxed)));
+
+    // Réglages temps réel appliqués par chaque thread à son démarrage
+    Napi::Object realtime = Napi::Object::New(env);
+    realtime.Set("deviceThread", RtThreadObject(env, deviceThreadStatus_));
+    Napi::Array workerThreads = Napi::Array::New(env, workers_.size());
+    for (size_t i = 0; i < workers_.size(); ++i)
+        workerThreads.Set((uint32_t)i, RtThreadObject(env, workers_[i]->status));
+    realtime.Set("workers", workerThreads);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("workers", Napi::Number::New(env, (double)workers_.size()));
+    result.Set("realtime", realtime);
+    result.Set("periods", periods);
+    result.Set("instances", instances);
+    result.Set("dsp", DspStatsObject(env, dspStats_.Load()));
+    result.Set("outputKernel", Napi::String::New(env, GainKernelName()));
+    return result;
+}
+
+// Device thread: no allocation, no locks, no N-API
+void PdMixer::AudioCallback(float *out, uint32_t frameCount)
+{
+    RtAllocScope rtScope;
+    const size_t channels = (size_t)channelsOut_;
+    const bool clip = clip_.load(std::memory_order_relaxed);
+    for (uint32_t pos = 0; pos < frameCount; pos += kMaxChunkFrames)
+    {
+        const uint32_t frames = frameCount - pos < kMaxChunkFrames ? frameCount - pos : kMaxChunkFrames;
+        const size_t count = (size_t)frames * channels;
+        float *dst = out + (size_t)pos * channels;
+        if (slots_.empty())
+        {
+            memset(dst, 0, count * sizeof(float));
+            continue;
+        }
+        RenderPeriod(frames);
+
+        // Bus : somme SIMD des sorties, chaque moteur a déjà appliqué son gain
+        memcpy(dst, slots_[0]->out, count * sizeof(float));
+        for (size_t i = 1; i < slots_.size(); ++i)
+            MixAdd(dst, slots_[i]->out, count, 1.0f);
+        if (clip)
+            ApplyGain(dst, dst, count, 1.0f, 1.0f, true, (uint32_t)channels);
+    }
+}
+
+void PdMixer::RenderPeriod(uint32_t frames)
+{
+    const uint32_t n = (uint32_t)slots_.size();
+    const uint32_t participants = (uint32_t)workers_.size() + 1 < n ? (uint32_t)workers_.size() + 1 : n;
+
+    // Un worker encore occupé par la période précédente lit peut-être encore les
+    // tranches : on ne les réécrit pas, cette période est rendue ici
+    if (participants <= 1 || busyWorkers_.load(std::memory_order_acquire) != 0)
+    {
+        for (auto &slot : slots_)
+            RenderSlot(*slot, frames);
+        inlinePeriods_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Les plus coûteux d'abord (tri par insertion, n reste petit), distribués en
+    // tourniquet : chaque participant commence par une tranche équilibrée
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        uint32_t j = i;
+        while (j > 0 && slots_[order_[j - 1]]->avgUs < slots_[i]->avgUs)
+        {
+            order_[j] = order_[j - 1];
+            --j;
+        }
+        order_[j] = i;
+    }
+    uint32_t pos = 0;
+    for (uint32_t p = 0; p < participants; ++p)
+    {
+        slices_[p].next.store(pos, std::memory_order_relaxed);
+        for (uint32_t k = p; k < n; k += participants)
+            tasks_[pos++] = order_[k];
+        slices_[p].end = pos;
+    }
+    sliceCount_ = participants;
+    periodFrames_ = frames;
+    pending_.store(n, std::memory_order_relaxed);
+    busyWorkers_.store(participants - 1, std::memory_order_relaxed);
+
+    // Le sémaphore publie l'état de la période aux workers
+    for (uint32_t w = 0; w + 1 < participants; ++w)
+        workers_[w]->wake.Post();
+    Participate(0);
+    WaitForTasks();
+    parallelPeriods_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Own slice first, then steal from the others until every counter is past its end
+void PdMixer::Participate(uint32_t self)
+{
+    for (uint32_t k = 0; k < sliceCount_; ++k)
+    {
+        Slice &slice = slices_[(self + k) % sliceCount_];
+        for (;;)
+        {
+            const uint32_t i = slice.next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= slice.end)
+                break;
+            RenderSlot(*slots_[tasks_[i]], periodFrames_);
+            FinishTask();
+        }
+    }
+}
+
+// Whoever finishes the last task wakes the device thread if it went to sleep.
+// pending_ and deviceWaiting_ are sequentially consistent: either the device
+// thread sees pending_ at zero, or this sees it waiting.
+void PdMixer::FinishTask()
+{
+    if (pending_.fetch_sub(1) == 1 && deviceWaiting_.exchange(false))
+        doneSem_.Post();
+}
+
+// Device thread: the other participants usually finish within a few microseconds
+// of it, so spin first. A longer wait (a slow engine on a worker, a preempted
+// worker) sleeps instead of burning the core the workers may need.
+void PdMixer::WaitForTasks()
+{
+    for (uint32_t spins = 0; spins < kMaxSpins; ++spins)
+    {
+        if (pending_.load(std::memory_order_acquire) == 0)
+            return;
+        CpuRelax();
+    }
+    deviceWaiting_.store(true);
+    if (pending_.load() != 0)
+        doneSem_.Wait();
+    else if (!deviceWaiting_.exchange(false))
+        doneSem_.Wait(); // le dernier worker a posté entre-temps : consommer son Post
+}
+
+void PdMixer::RenderSlot(Slot &slot, uint32_t frames)
+{
+    const auto start = std::chrono::steady_clock::now();
+    slot.out = slot.engine->RenderForMixer(frames);
+    const float us = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    slot.avgUs = slot.renders.load(std::memory_order_relaxed) == 0 ? us : slot.avgUs + 0.05f * (us - slot.avgUs);
+    slot.lastUs.store(us, std::memory_order_relaxed);
+    slot.meanUs.store(slot.avgUs, std::memory_order_relaxed);
+    if (us > slot.maxUs.load(std::memory_order_relaxed))
+        slot.maxUs.store(us, std::memory_order_relaxed);
+    slot.renders.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PdMixer::WorkerMain(Worker *worker)
+{
+    ApplyRtThreadOptions(rtOptions_, worker->status);
+    ScopedDenormalGuard denormals(denormalProtection_);
+    for (;;)
+    {
+        worker->wake.Wait();
+        if (stopWorkers_.load(std::memory_order_acquire))
+            break;
+        {
+            RtAllocScope rtScope;
+            Participate(worker->index);
+        }
+        busyWorkers_.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+// JS thread, device stopped. Never more workers than engines minus the device thread.
+void PdMixer::StartWorkers()
+{
+    const size_t wanted = slots_.size() > 1 ? slots_.size() - 1 : 0;
+    const size_t count = (size_t)workerCount_ < wanted ? (size_t)workerCount_ : wanted;
+    stopWorkers_.store(false, std::memory_order_relaxed);
+    busyWorkers_.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->index = (uint32_t)i + 1;
+        worker->thread = std::thread(&PdMixer::WorkerMain, this, worker.get());
+        workers_.push_back(std::move(worker));
+    }
+}
+
+void PdMixer::StopWorkers()
+{
+    stopWorkers_.store(true, std::memory_order_release);
+    for (auto &worker : workers_)
+        worker->wake.Post();
+    for (auto &worker : workers_)
+        worker->thread.join();
+    workers_.clear();
+}
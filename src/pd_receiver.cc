@@ -0,0 +1,88 @@
+#include "pd_receiver.h"
+#include "pd_engine.h"
+#include <cmath>
+
+Napi::Object PdReceiver::Init(Napi::Env env, Napi::Object exports)
+{
+    Napi::Function func = DefineClass(env, "PdReceiver",
+                                      {PdReceiver::InstanceMethod("set", &PdReceiver::set),
+                                       PdReceiver::InstanceMethod("bang", &PdReceiver::bang),
+                                       PdReceiver::InstanceAccessor("name", &PdReceiver::getName, nullptr)});
+
+    // Pas exporté : les instances viennent de engine.receiver(name)
+    env.GetInstanceData<PdAddonData>()->receiver = Napi::Persistent(func);
+    return exports;
+}
+
+Napi::Object PdReceiver::New(Napi::Env env, Napi::Object engine, PdReceiverHandle *handle)
+{
+    Napi::Object obj = env.GetInstanceData<PdAddonData>()->receiver.New({engine, Napi::External<PdReceiverHandle>::New(env, handle)});
+    return obj;
+}
+
+PdReceiver::PdReceiver(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<PdReceiver>(info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsExternal())
+    {
+        Napi::TypeError::New(env, "use engine.receiver(name)").ThrowAsJavaScriptException();
+        return;
+    }
+    Napi::Object engine = info[0].As<Napi::Object>();
+    engine_ = PdEngine::Unwrap(engine);
+    engineRef_ = Napi::Persistent(engine);
+    handle_ = info[1].As<Napi::External<PdReceiverHandle>>().Data();
+}
+
+// Optional trailing sampleTime, as for send*At
+bool PdReceiver::ReadTime(const Napi::CallbackInfo &info, size_t index, uint64_t &time)
+{
+    time = 0;
+    if (info.Length() <= index || info[index].IsUndefined())
+        return true;
+    double t;
+    if (info[index].IsNumber())
+        t = info[index].As<Napi::Number>().DoubleValue();
+    else if (info[index].IsBigInt())
+    {
+        bool lossless = true;
+        t = (double)info[index].As<Napi::BigInt>().Int64Value(&lossless);
+    }
+    else
+        return false;
+    if (!std::isfinite(t))
+        return false;
+    time = t > 0.0 ? (uint64_t)t : 0;
+    return true;
+}
+
+Napi::Value PdReceiver::set(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    uint64_t time;
+    if (info.Length() < 1 || !info[0].IsNumber() || !ReadTime(info, 1, time))
+    {
+        Napi::TypeError::New(env, "(value: number, sampleTime?: number | bigint)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    const float value = info[0].As<Napi::Number>().FloatValue();
+    return Napi::Boolean::New(env, engine_->PostHandle(PdCommandType::HandleFloat, handle_, value, time));
+}
+
+Napi::Value PdReceiver::bang(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    uint64_t time;
+    if (!ReadTime(info, 0, time))
+    {
+        Napi::TypeError::New(env, "(sampleTime?: number | bigint)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return Napi::Boolean::New(env, engine_->PostHandle(PdCommandType::HandleBang, handle_, 0.0f, time));
+}
+
+Napi::Value PdReceiver::getName(const Napi::CallbackInfo &info)
+{
+    return Napi::String::New(info.Env(), handle_->name);
+}
@@ -0,0 +1,84 @@
+#include "rt_alloc_guard.h"
+
+#ifdef PD_RT_ALLOC_CHECK
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Replacement global allocation functions. They are linked into the addon only
+// (see WITH_RT_ALLOC_CHECK in CMakeLists.txt, which also binds them locally on
+// Linux), so they see exactly the allocations made by our own code.
+
+namespace
+{
+thread_local int t_realtimeDepth = 0;
+
+[[noreturn]] void Trap(const char *what)
+{
+    std::fputs("node-libpd-napi: ", stderr);
+    std::fputs(what, stderr);
+    std::fputs(" called from the audio thread\n", stderr);
+    std::abort();
+}
+
+void *Allocate(std::size_t size, std::size_t align, bool nothrow)
+{
+    if (t_realtimeDepth > 0)
+        Trap("operator new");
+    if (size == 0)
+        size = 1;
+    void *p = nullptr;
+    if (align <= alignof(std::max_align_t))
+    {
+        p = std::malloc(size);
+    }
+    else
+    {
+        // aligned_alloc veut une taille multiple de l'alignement
+        size = (size + align - 1) / align * align;
+        p = std::aligned_alloc(align, size);
+    }
+    if (!p && !nothrow)
+        throw std::bad_alloc();
+    return p;
+}
+
+void Deallocate(void *p) noexcept
+{
+    if (!p)
+        return;
+    if (t_realtimeDepth > 0)
+        Trap("operator delete");
+    std::free(p);
+}
+} // namespace
+
+namespace rt_alloc
+{
+void EnterRealtime() { ++t_realtimeDepth; }
+void LeaveRealtime() { --t_realtimeDepth; }
+}
+
+void *operator new(std::size_t size) { return Allocate(size, 0, false); }
+void *operator new[](std::size_t size) { return Allocate(size, 0, false); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return Allocate(size, 0, true); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return Allocate(size, 0, true); }
+void *operator new(std::size_t size, std::align_val_t al) { return Allocate(size, (std::size_t)al, false); }
+void *operator new[](std::size_t size, std::align_val_t al) { return Allocate(size, (std::size_t)al, false); }
+void *operator new(std::size_t size, std::align_val_t al, const std::nothrow_t &) noexcept { return Allocate(size, (std::size_t)al, true); }
+void *operator new[](std::size_t size, std::align_val_t al, const std::nothrow_t &) noexcept { return Allocate(size, (std::size_t)al, true); }
+
+void operator delete(void *p) noexcept { Deallocate(p); }
+void operator delete[](void *p) noexcept { Deallocate(p); }
+void operator delete(void *p, std::size_t) noexcept { Deallocate(p); }
+void operator delete[](void *p, std::size_t) noexcept { Deallocate(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { Deallocate(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { Deallocate(p); }
+void operator delete(void *p, std::align_val_t) noexcept { Deallocate(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { Deallocate(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { Deallocate(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { Deallocate(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { Deallocate(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { Deallocate(p); }
+#endif
@@ -0,0 +1,55 @@
+#include "rt_thread.h"
+
+#include <cerrno>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+void ApplyRtThreadOptions(const RtThreadOptions &options, RtThreadStatus &status)
+{
+#if defined(__linux__)
+    if (options.policy != RtSchedPolicy::Default)
+    {
+        const int policy = options.policy == RtSchedPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+        int priority = options.priority;
+        const int minPriority = sched_get_priority_min(policy);
+        const int maxPriority = sched_get_priority_max(policy);
+        if (priority < minPriority)
+            priority = minPriority;
+        if (priority > maxPriority)
+            priority = maxPriority;
+        struct sched_param param = {};
+        param.sched_priority = priority;
+        status.sched.store(pthread_setschedparam(pthread_self(), policy, &param), std::memory_order_relaxed);
+    }
+    if (options.cpuCount > 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int i = 0; i < options.cpuCount; ++i)
+        {
+            if (options.cpus[i] >= 0 && options.cpus[i] < CPU_SETSIZE)
+                CPU_SET(options.cpus[i], &set);
+        }
+        status.affinity.store(pthread_setaffinity_np(pthread_self(), sizeof(set), &set), std::memory_order_relaxed);
+    }
+#else
+    if (options.policy != RtSchedPolicy::Default)
+        status.sched.store(ENOTSUP, std::memory_order_relaxed);
+    if (options.cpuCount > 0)
+        status.affinity.store(ENOTSUP, std::memory_order_relaxed);
+#endif
+    status.applied.store(true, std::memory_order_release);
+}
+
+int LockProcessMemory()
+{
+#if defined(__linux__)
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? 0 : errno;
+#else
+    return ENOTSUP;
+#endif
+}
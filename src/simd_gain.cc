@@ -0,0 +1,660 @@
+#include "simd_gain.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PD_GAIN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PD_GAIN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(PD_GAIN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PD_TARGET_AVX2 __attribute__((target("avx2")))
+#define PD_TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define PD_TARGET_AVX2
+#define PD_TARGET_SSE2
+#endif
+
+namespace
+{
+typedef void (*GainKernel)(float *, const float *, size_t, float, float, bool, uint32_t);
+typedef void (*MixKernel)(float *, const float *, size_t, float);
+typedef void (*MeterKernel)(float *, const float *, size_t, float, float, bool, uint32_t, ChannelLevels &);
+
+inline float ClipSample(float x)
+{
+    return x > 1.0f ? 1.0f : (x < -1.0f ? -1.0f : x);
+}
+
+// Queue scalaire commune, à partir de l'échantillon `start`. La rampe avance
+// d'un pas par frame : tous les canaux d'une frame ont le même gain.
+inline void GainTail(float *dst, const float *src, size_t start, size_t count, float g0, float step, bool clip,
+                     uint32_t channels)
+{
+    size_t frame = start / channels;
+    uint32_t ch = (uint32_t)(start % channels);
+    for (size_t i = start; i < count; ++i)
+    {
+        float x = src[i] * (g0 + step * (float)frame);
+        dst[i] = clip ? ClipSample(x) : x;
+        if (++ch == channels)
+        {
+            ch = 0;
+            ++frame;
+        }
+    }
+}
+
+// Variante mesurée : le canal de l'échantillon i est i % channels
+inline void GainMeterTail(float *dst, const float *src, size_t start, size_t count, float g0, float step, bool clip,
+                          uint32_t channels, ChannelLevels &levels)
+{
+    size_t frame = start / channels;
+    uint32_t ch = (uint32_t)(start % channels);
+    for (size_t i = start; i < count; ++i)
+    {
+        float x = src[i] * (g0 + step * (float)frame);
+        if (clip)
+            x = ClipSample(x);
+        dst[i] = x;
+        if (ch < kMeterMaxChannels)
+        {
+            const float a = std::fabs(x);
+            if (a > levels.peak[ch])
+                levels.peak[ch] = a;
+            levels.sumSquares[ch] += x * x;
+        }
+        if (++ch == channels)
+        {
+            ch = 0;
+            ++frame;
+        }
+    }
+}
+
+// Frame de chaque voie SIMD. Une suite de vecteurs de `lanes` voies retombe sur le
+// même découpage en frames tous les ppcm(lanes, channels) échantillons :
+// offsets[j * lanes + l] est la frame de la voie l du vecteur j, relative au début
+// de ce motif, et `frames` le nombre de frames qu'il couvre. Renvoie le nombre de
+// vecteurs du motif, 0 s'il en faut plus de kMaxPatternVectors (frames de plus de
+// 16 canaux : on diffuse alors un gain par frame).
+constexpr uint32_t kMaxPatternVectors = 16;
+
+inline uint32_t FramePattern(float *offsets, uint32_t lanes, uint32_t channels, uint32_t &frames)
+{
+    uint32_t a = lanes, b = channels;
+    while (b != 0)
+    {
+        const uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    const uint32_t vectors = channels / a;
+    if (vectors > kMaxPatternVectors)
+        return 0;
+    for (uint32_t n = 0; n < vectors * lanes; ++n)
+        offsets[n] = (float)(n / channels);
+    frames = vectors * lanes / channels;
+    return vectors;
+}
+
+// Accumulateurs des voies SIMD vers les canaux : la voie l porte le canal l % channels
+inline void FoldLanes(const float *peak, const float *sum, uint32_t lanes, uint32_t channels, ChannelLevels &levels)
+{
+    for (uint32_t l = 0; l < lanes; ++l)
+    {
+        const uint32_t ch = l % channels;
+        if (peak[l] > levels.peak[ch])
+            levels.peak[ch] = peak[l];
+        levels.sumSquares[ch] += sum[l];
+    }
+}
+
+// Passe de niveaux seule, pour les dispositions que les noyaux fusionnés ne couvrent
+// pas (3, 5, 6 canaux...) : relit dst juste après le gain, encore en cache. La
+// boucle interne, sur les canaux d'une frame, se vectorise.
+inline void LevelPass(const float *x, size_t count, uint32_t channels, ChannelLevels &levels)
+{
+    const uint32_t metered = channels < kMeterMaxChannels ? channels : kMeterMaxChannels;
+    float peak[kMeterMaxChannels];
+    float sum[kMeterMaxChannels];
+    for (uint32_t ch = 0; ch < metered; ++ch)
+    {
+        peak[ch] = levels.peak[ch];
+        sum[ch] = 0.0f;
+    }
+    for (size_t i = 0; i < count; i += channels)
+    {
+        for (uint32_t ch = 0; ch < metered; ++ch)
+        {
+            const float v = x[i + ch];
+            const float a = std::fabs(v);
+            peak[ch] = a > peak[ch] ? a : peak[ch];
+            sum[ch] += v * v;
+        }
+    }
+    for (uint32_t ch = 0; ch < metered; ++ch)
+    {
+        levels.peak[ch] = peak[ch];
+        levels.sumSquares[ch] += sum[ch];
+    }
+}
+
+inline void MixTail(float *dst, const float *src, size_t start, size_t count, float gain)
+{
+    for (size_t i = start; i < count; ++i)
+        dst[i] += src[i] * gain;
+}
+
+#if !defined(PD_GAIN_X86) && !defined(PD_GAIN_NEON)
+void GainScalar(float *dst, const float *src, size_t count, float g0, float step, bool clip, uint32_t channels)
+{
+    GainTail(dst, src, 0, count, g0, step, clip, channels);
+}
+
+void MixScalar(float *dst, const float *src, size_t count, float gain)
+{
+    MixTail(dst, src, 0, count, gain);
+}
+
+void GainMeterScalar(float *dst, const float *src, size_t count, float g0, float step, bool clip, uint32_t channels,
+                     ChannelLevels &levels)
+{
+    GainMeterTail(dst, src, 0, count, g0, step, clip, channels, levels);
+}
+#endif
+
+#ifdef PD_GAIN_X86
+// g = g0 + step * frame, calculé comme dans GainTail pour que les voies SIMD et la
+// queue scalaire donnent exactement le même gain
+PD_TARGET_SSE2 void GainSse2(float *dst, const float *src, size_t count, float g0, float step, bool clip,
+                             uint32_t channels)
+{
+    const __m128 gStart = _mm_set1_ps(g0);
+    const __m128 gStep = _mm_set1_ps(step);
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    float offsets[kMaxPatternVectors * 4];
+    uint32_t patternFrames = 0;
+    const uint32_t vectors = FramePattern(offsets, 4, channels, patternFrames);
+    size_t i = 0;
+    if (vectors > 0)
+    {
+        size_t frame = 0;
+        uint32_t j = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 f = _mm_add_ps(_mm_set1_ps((float)frame), _mm_loadu_ps(offsets + 4 * j));
+            __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_add_ps(gStart, _mm_mul_ps(gStep, f)));
+            if (clip)
+                x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+            _mm_storeu_ps(dst + i, x);
+            if (++j == vectors)
+            {
+                j = 0;
+                frame += patternFrames;
+            }
+        }
+    }
+    else
+    {
+        for (size_t frame = 0; i < count; ++frame)
+        {
+            const __m128 g = _mm_set1_ps(g0 + step * (float)frame);
+            const size_t end = i + channels;
+            for (; i + 4 <= end; i += 4)
+            {
+                __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+                if (clip)
+                    x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+                _mm_storeu_ps(dst + i, x);
+            }
+            GainTail(dst, src, i, end, g0, step, clip, channels);
+            i = end;
+        }
+    }
+    GainTail(dst, src, i, count, g0, step, clip, channels);
+}
+
+PD_TARGET_AVX2 void GainAvx2(float *dst, const float *src, size_t count, float g0, float step, bool clip,
+                             uint32_t channels)
+{
+    const __m256 gStart = _mm256_set1_ps(g0);
+    const __m256 gStep = _mm256_set1_ps(step);
+    const __m256 lo = _mm256_set1_ps(-1.0f);
+    const __m256 hi = _mm256_set1_ps(1.0f);
+    float offsets[kMaxPatternVectors * 8];
+    uint32_t patternFrames = 0;
+    const uint32_t vectors = FramePattern(offsets, 8, channels, patternFrames);
+    size_t i = 0;
+    if (vectors > 0)
+    {
+        size_t frame = 0;
+        uint32_t j = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256 f = _mm256_add_ps(_mm256_set1_ps((float)frame), _mm256_loadu_ps(offsets + 8 * j));
+            __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_add_ps(gStart, _mm256_mul_ps(gStep, f)));
+            if (clip)
+                x = _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+            _mm256_storeu_ps(dst + i, x);
+            if (++j == vectors)
+            {
+                j = 0;
+                frame += patternFrames;
+            }
+        }
+    }
+    else
+    {
+        for (size_t frame = 0; i < count; ++frame)
+        {
+            const __m256 g = _mm256_set1_ps(g0 + step * (float)frame);
+            const size_t end = i + channels;
+            for (; i + 8 <= end; i += 8)
+            {
+                __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+                if (clip)
+                    x = _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+                _mm256_storeu_ps(dst + i, x);
+            }
+            GainTail(dst, src, i, end, g0, step, clip, channels);
+            i = end;
+        }
+    }
+    GainTail(dst, src, i, count, g0, step, clip, channels);
+}
+
+PD_TARGET_SSE2 void GainMeterSse2(float *dst, const float *src, size_t count, float g0, float step, bool clip,
+                                  uint32_t channels, ChannelLevels &levels)
+{
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t i = 0;
+    if (4 % channels == 0)
+    {
+        // Chaque vecteur couvre 4 / channels frames entières
+        const float fpv = (float)(4 / channels);
+        const __m128 gStart = _mm_set1_ps(g0);
+        const __m128 gStep = _mm_set1_ps(step);
+        const __m128 offsets = _mm_setr_ps(0.0f, (float)(1 / channels), (float)(2 / channels), (float)(3 / channels));
+        float frame = 0.0f;
+        __m128 peak = _mm_setzero_ps();
+        __m128 sum = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4, frame += fpv)
+        {
+            const __m128 g = _mm_add_ps(gStart, _mm_mul_ps(gStep, _mm_add_ps(_mm_set1_ps(frame), offsets)));
+            __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+            if (clip)
+                x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+            _mm_storeu_ps(dst + i, x);
+            peak = _mm_max_ps(peak, _mm_andnot_ps(sign, x));
+            sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+        }
+        float p[4], q[4];
+        _mm_storeu_ps(p, peak);
+        _mm_storeu_ps(q, sum);
+        FoldLanes(p, q, 4, channels, levels);
+        GainMeterTail(dst, src, i, count, g0, step, clip, channels, levels);
+    }
+    else if (channels % 4 == 0)
+    {
+        // Frames de plusieurs vecteurs entiers : un gain par frame, et le vecteur j
+        // d'une frame, (i % channels) / 4, a ses propres accumulateurs
+        const uint32_t vectors = channels / 4;
+        const uint32_t metered = vectors < kMeterMaxChannels / 4 ? vectors : kMeterMaxChannels / 4;
+        __m128 peak[kMeterMaxChannels / 4];
+        __m128 sum[kMeterMaxChannels / 4];
+        for (uint32_t j = 0; j < metered; ++j)
+            peak[j] = sum[j] = _mm_setzero_ps();
+        for (size_t frame = 0; i < count; ++frame)
+        {
+            const __m128 g = _mm_set1_ps(g0 + step * (float)frame);
+            uint32_t j = 0;
+            for (; j < metered; ++j, i += 4)
+            {
+                __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+                if (clip)
+                    x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+                _mm_storeu_ps(dst + i, x);
+                peak[j] = _mm_max_ps(peak[j], _mm_andnot_ps(sign, x));
+                sum[j] = _mm_add_ps(sum[j], _mm_mul_ps(x, x));
+            }
+            for (; j < vectors; ++j, i += 4)
+            {
+                __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+                if (clip)
+                    x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+                _mm_storeu_ps(dst + i, x);
+            }
+        }
+        float p[kMeterMaxChannels], q[kMeterMaxChannels];
+        for (uint32_t j = 0; j < metered; ++j)
+        {
+            _mm_storeu_ps(p + 4 * j, peak[j]);
+            _mm_storeu_ps(q + 4 * j, sum[j]);
+        }
+        FoldLanes(p, q, 4 * metered, channels, levels);
+    }
+    else
+    {
+        GainSse2(dst, src, count, g0, step, clip, channels);
+        LevelPass(dst, count, channels, levels);
+    }
+}
+
+PD_TARGET_AVX2 void GainMeterAvx2(float *dst, const float *src, size_t count, float g0, float step, bool clip,
+                                  uint32_t channels, ChannelLevels &levels)
+{
+    const __m256 lo = _mm256_set1_ps(-1.0f);
+    const __m256 hi = _mm256_set1_ps(1.0f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t i = 0;
+    if (8 % channels == 0)
+    {
+        const float fpv = (float)(8 / channels);
+        const __m256 gStart = _mm256_set1_ps(g0);
+        const __m256 gStep = _mm256_set1_ps(step);
+        const __m256 offsets =
+            _mm256_setr_ps(0.0f, (float)(1 / channels), (float)(2 / channels), (float)(3 / channels),
+                           (float)(4 / channels), (float)(5 / channels), (float)(6 / channels), (float)(7 / channels));
+        float frame = 0.0f;
+        __m256 peak = _mm256_setzero_ps();
+        __m256 sum = _mm256_setzero_ps();
+        for (; i + 8 <= count; i += 8, frame += fpv)
+        {
+            const __m256 g =
+                _mm256_add_ps(gStart, _mm256_mul_ps(gStep, _mm256_add_ps(_mm256_set1_ps(frame), offsets)));
+            __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+            if (clip)
+                x = _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+            _mm256_storeu_ps(dst + i, x);
+            peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, x));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(x, x));
+        }
+        float p[8], q[8];
+        _mm256_storeu_ps(p, peak);
+        _mm256_storeu_ps(q, sum);
+        FoldLanes(p, q, 8, channels, levels);
+        GainMeterTail(dst, src, i, count, g0, step, clip, channels, levels);
+    }
+    else if (channels % 8 == 0)
+    {
+        const uint32_t vectors = channels / 8;
+        const uint32_t metered = vectors < kMeterMaxChannels / 8 ? vectors : kMeterMaxChannels / 8;
+        __m256 peak[kMeterMaxChannels / 8];
+        __m256 sum[kMeterMaxChannels / 8];
+        for (uint32_t j = 0; j < metered; ++j)
+            peak[j] = sum[j] = _mm256_setzero_ps();
+        for (size_t frame = 0; i < count; ++frame)
+        {
+            const __m256 g = _mm256_set1_ps(g0 + step * (float)frame);
+            uint32_t j = 0;
+            for (; j < metered; ++j, i += 8)
+            {
+                __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+                if (clip)
+                    x = _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+                _mm256_storeu_ps(dst + i, x);
+                peak[j] = _mm256_max_ps(peak[j], _mm256_andnot_ps(sign, x));
+                sum[j] = _mm256_add_ps(sum[j], _mm256_mul_ps(x, x));
+            }
+            for (; j < vectors; ++j, i += 8)
+            {
+                __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+                if (clip)
+                    x = _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+                _mm256_storeu_ps(dst + i, x);
+            }
+        }
+        float p[kMeterMaxChannels], q[kMeterMaxChannels];
+        for (uint32_t j = 0; j < metered; ++j)
+        {
+            _mm256_storeu_ps(p + 8 * j, peak[j]);
+            _mm256_storeu_ps(q + 8 * j, sum[j]);
+        }
+        FoldLanes(p, q, 8 * metered, channels, levels);
+    }
+    else
+    {
+        GainAvx2(dst, src, count, g0, step, clip, channels);
+        LevelPass(dst, count, channels, levels);
+    }
+}
+
+PD_TARGET_SSE2 void MixSse2(float *dst, const float *src, size_t count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    MixTail(dst, src, i, count, gain);
+}
+
+PD_TARGET_AVX2 void MixAvx2(float *dst, const float *src, size_t count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+    MixTail(dst, src, i, count, gain);
+}
+
+bool CpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef PD_GAIN_NEON
+void GainNeon(float *dst, const float *src, size_t count, float g0, float step, bool clip, uint32_t channels)
+{
+    const float32x4_t gStart = vdupq_n_f32(g0);
+    const float32x4_t gStep = vdupq_n_f32(step);
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    float offsets[kMaxPatternVectors * 4];
+    uint32_t patternFrames = 0;
+    const uint32_t vectors = FramePattern(offsets, 4, channels, patternFrames);
+    size_t i = 0;
+    if (vectors > 0)
+    {
+        size_t frame = 0;
+        uint32_t j = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const float32x4_t f = vaddq_f32(vdupq_n_f32((float)frame), vld1q_f32(offsets + 4 * j));
+            float32x4_t x = vmulq_f32(vld1q_f32(src + i), vaddq_f32(gStart, vmulq_f32(gStep, f)));
+            if (clip)
+                x = vminq_f32(vmaxq_f32(x, lo), hi);
+            vst1q_f32(dst + i, x);
+            if (++j == vectors)
+            {
+                j = 0;
+                frame += patternFrames;
+            }
+        }
+    }
+    else
+    {
+        for (size_t frame = 0; i < count; ++frame)
+        {
+            const float32x4_t g = vdupq_n_f32(g0 + step * (float)frame);
+            const size_t end = i + channels;
+            for (; i + 4 <= end; i += 4)
+            {
+                float32x4_t x = vmulq_f32(vld1q_f32(src + i), g);
+                if (clip)
+                    x = vminq_f32(vmaxq_f32(x, lo), hi);
+                vst1q_f32(dst + i, x);
+            }
+            GainTail(dst, src, i, end, g0, step, clip, channels);
+            i = end;
+        }
+    }
+    GainTail(dst, src, i, count, g0, step, clip, channels);
+}
+
+void GainMeterNeon(float *dst, const float *src, size_t count, float g0, float step, bool clip, uint32_t channels,
+                   ChannelLevels &levels)
+{
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    size_t i = 0;
+    if (4 % channels == 0)
+    {
+        const float fpv = (float)(4 / channels);
+        const float init[4] = {0.0f, (float)(1 / channels), (float)(2 / channels), (float)(3 / channels)};
+        const float32x4_t offsets = vld1q_f32(init);
+        const float32x4_t gStart = vdupq_n_f32(g0);
+        const float32x4_t gStep = vdupq_n_f32(step);
+        float frame = 0.0f;
+        float32x4_t peak = vdupq_n_f32(0.0f);
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (; i + 4 <= count; i += 4, frame += fpv)
+        {
+            const float32x4_t g = vaddq_f32(gStart, vmulq_f32(gStep, vaddq_f32(vdupq_n_f32(frame), offsets)));
+            float32x4_t x = vmulq_f32(vld1q_f32(src + i), g);
+            if (clip)
+                x = vminq_f32(vmaxq_f32(x, lo), hi);
+            vst1q_f32(dst + i, x);
+            peak = vmaxq_f32(peak, vabsq_f32(x));
+            sum = vmlaq_f32(sum, x, x);
+        }
+        float p[4], q[4];
+        vst1q_f32(p, peak);
+        vst1q_f32(q, sum);
+        FoldLanes(p, q, 4, channels, levels);
+        GainMeterTail(dst, src, i, count, g0, step, clip, channels, levels);
+    }
+    else if (channels % 4 == 0)
+    {
+        const uint32_t vectors = channels / 4;
+        const uint32_t metered = vectors < kMeterMaxChannels / 4 ? vectors : kMeterMaxChannels / 4;
+        float32x4_t peak[kMeterMaxChannels / 4];
+        float32x4_t sum[kMeterMaxChannels / 4];
+        for (uint32_t j = 0; j < metered; ++j)
+            peak[j] = sum[j] = vdupq_n_f32(0.0f);
+        for (size_t frame = 0; i < count; ++frame)
+        {
+            const float32x4_t g = vdupq_n_f32(g0 + step * (float)frame);
+            uint32_t j = 0;
+            for (; j < metered; ++j, i += 4)
+            {
+                float32x4_t x = vmulq_f32(vld1q_f32(src + i), g);
+                if (clip)
+                    x = vminq_f32(vmaxq_f32(x, lo), hi);
+                vst1q_f32(dst + i, x);
+                peak[j] = vmaxq_f32(peak[j], vabsq_f32(x));
+                sum[j] = vmlaq_f32(sum[j], x, x);
+            }
+            for (; j < vectors; ++j, i += 4)
+            {
+                float32x4_t x = vmulq_f32(vld1q_f32(src + i), g);
+                if (clip)
+                    x = vminq_f32(vmaxq_f32(x, lo), hi);
+                vst1q_f32(dst + i, x);
+            }
+        }
+        float p[kMeterMaxChannels], q[kMeterMaxChannels];
+        for (uint32_t j = 0; j < metered; ++j)
+        {
+            vst1q_f32(p + 4 * j, peak[j]);
+            vst1q_f32(q + 4 * j, sum[j]);
+        }
+        FoldLanes(p, q, 4 * metered, channels, levels);
+    }
+    else
+    {
+        GainNeon(dst, src, count, g0, step, clip, channels);
+        LevelPass(dst, count, channels, levels);
+    }
+}
+
+void MixNeon(float *dst, const float *src, size_t count, float gain)
+{
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), vld1q_f32(src + i), g));
+    MixTail(dst, src, i, count, gain);
+}
+#endif
+
+struct KernelChoice
+{
+    GainKernel fn;
+    MixKernel mix;
+    MeterKernel meter;
+    const char *name;
+};
+
+KernelChoice SelectKernel()
+{
+#if defined(PD_GAIN_X86)
+    if (CpuHasAvx2())
+        return {&GainAvx2, &MixAvx2, &GainMeterAvx2, "avx2"};
+    return {&GainSse2, &MixSse2, &GainMeterSse2, "sse2"};
+#elif defined(PD_GAIN_NEON)
+    return {&GainNeon, &MixNeon, &GainMeterNeon, "neon"};
+#else
+    return {&GainScalar, &MixScalar, &GainMeterScalar, "scalar"};
+#endif
+}
+
+// Choisi une fois au chargement de l'addon, jamais depuis le thread audio
+const KernelChoice g_kernel = SelectKernel();
+} // namespace
+
+void ApplyGain(float *dst, const float *src, size_t count, float gainStart, float gainEnd, bool clip,
+               uint32_t channels)
+{
+    if (count == 0 || channels == 0)
+        return;
+    // Pas par frame : count est un nombre entier de frames
+    const float step = gainStart == gainEnd ? 0.0f : (gainEnd - gainStart) / (float)(count / channels);
+    g_kernel.fn(dst, src, count, gainStart, step, clip, channels);
+}
+
+void ApplyGainMetered(float *dst, const float *src, size_t count, float gainStart, float gainEnd, bool clip,
+                      uint32_t channels, ChannelLevels &levels)
+{
+    if (count == 0 || channels == 0)
+        return;
+    const float step = gainStart == gainEnd ? 0.0f : (gainEnd - gainStart) / (float)(count / channels);
+    g_kernel.meter(dst, src, count, gainStart, step, clip, channels, levels);
+}
+
+void MixAdd(float *dst, const float *src, size_t count, float gain)
+{
+    if (count == 0)
+        return;
+    g_kernel.mix(dst, src, count, gain);
+}
+
+const char *GainKernelName()
+{
+    return g_kernel.name;
+}
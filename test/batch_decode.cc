@@ -0,0 +1,114 @@
+// Decoder side of test/batch_roundtrip.js: reads framed sendBatch() buffers from
+// stdin (u32 little-endian length, then the bytes, for each case), decodes every
+// record with DecodePdBatchRecord and prints one JSON line per record, then
+// {"end":offset} when the whole buffer was consumed or {"error":offset} at the
+// first record it rejects. No libpd, no Node: only include/ headers.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pd_batch.h"
+
+static const char *kTypeNames[] = {"bang", "float", "symbol", "list"};
+
+static std::string JsonString(const char *s)
+{
+    std::string out = "\"";
+    for (; *s != '\0'; ++s)
+    {
+        const unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += (char)c;
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+        {
+            out += (char)c;
+        }
+    }
+    return out + "\"";
+}
+
+static void PrintRecord(const PdCommand &cmd)
+{
+    std::printf("{\"type\":\"%s\",\"time\":%llu,\"receiver\":%s", kTypeNames[(int)cmd.type],
+                (unsigned long long)cmd.time, JsonString(cmd.receiver).c_str());
+    switch (cmd.type)
+    {
+    case PdCommandType::Float:
+        std::printf(",\"value\":%.17g", (double)cmd.value);
+        break;
+    case PdCommandType::Symbol:
+        std::printf(",\"symbol\":%s", JsonString(cmd.symbol).c_str());
+        break;
+    case PdCommandType::List:
+    {
+        std::printf(",\"argc\":%u,\"atoms\":[", (unsigned)cmd.argc);
+        PdAtomReader reader(cmd.payload, cmd.size);
+        PdAtomView atom;
+        for (int i = 0; reader.Next(atom); ++i)
+        {
+            if (atom.isSymbol)
+                std::printf("%s%s", i ? "," : "", JsonString(atom.s).c_str());
+            else
+                std::printf("%s%.17g", i ? "," : "", (double)atom.f);
+        }
+        std::printf("]");
+        break;
+    }
+    default:
+        break;
+    }
+    std::printf("}\n");
+}
+
+int main()
+{
+    std::vector<uint8_t> input;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+        input.insert(input.end(), chunk, chunk + n);
+
+    size_t pos = 0;
+    while (pos + sizeof(uint32_t) <= input.size())
+    {
+        const uint32_t length = (uint32_t)input[pos] | (uint32_t)input[pos + 1] << 8 |
+                                (uint32_t)input[pos + 2] << 16 | (uint32_t)input[pos + 3] << 24;
+        pos += sizeof(uint32_t);
+        if (length > input.size() - pos)
+        {
+            std::fprintf(stderr, "truncated frame\n");
+            return 2;
+        }
+        // Copie exacte : une lecture au-delà du record tomberait hors du buffer
+        const std::vector<uint8_t> batch(input.begin() + (std::ptrdiff_t)pos,
+                                         input.begin() + (std::ptrdiff_t)(pos + length));
+        pos += length;
+
+        size_t offset = 0;
+        while (offset < batch.size())
+        {
+            PdCommand cmd{};
+            const size_t size = DecodePdBatchRecord(batch.data() + offset, batch.size() - offset, cmd);
+            if (size == 0)
+                break;
+            PrintRecord(cmd);
+            offset += size;
+        }
+        if (offset == batch.size())
+            std::printf("{\"end\":%zu}\n", offset);
+        else
+            std::printf("{\"error\":%zu}\n", offset);
+    }
+    return 0;
+}
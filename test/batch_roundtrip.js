@@ -0,0 +1,196 @@
+'use strict'
+
+// Round trip of the sendBatch() encoding: batches built with js/batch.js are
+// decoded by DecodePdBatchRecord (include/pd_batch.h) in test/batch_decode.cc.
+//   node test/batch_roundtrip.js path/to/batch_decode
+// or through CMake: -DBUILD_TESTS=ON, then ctest.
+
+const assert = require('assert')
+const { spawnSync } = require('child_process')
+const { PdBatch } = require('../js/batch')
+
+const decoder = process.argv[2]
+if (!decoder) {
+    console.error('usage: node test/batch_roundtrip.js <batch_decode>')
+    process.exit(2)
+}
+
+// Tous les cas passent en une seule exécution du décodeur
+function decode(batches) {
+    const frames = []
+    for (const bytes of batches) {
+        const header = Buffer.alloc(4)
+        header.writeUInt32LE(bytes.length, 0)
+        frames.push(header, Buffer.from(bytes.buffer, bytes.byteOffset, bytes.length))
+    }
+    const run = spawnSync(decoder, [], { input: Buffer.concat(frames) })
+    assert.strictEqual(run.status, 0, `decoder failed: ${run.stderr}`)
+    const results = []
+    let records = []
+    for (const line of run.stdout.toString().split('\n')) {
+        if (!line) continue
+        const entry = JSON.parse(line)
+        if ('end' in entry || 'error' in entry) {
+            results.push({ records, ...entry })
+            records = []
+        } else {
+            records.push(entry)
+        }
+    }
+    assert.strictEqual(results.length, batches.length)
+    return results
+}
+
+// Record header: type, flags, u16 size, the f64 time when given, then the receiver name
+function rawRecord(type, name, body, time) {
+    const nameBytes = Buffer.from(name)
+    const timeSize = time === undefined ? 0 : 8
+    const size = 4 + timeSize + 1 + nameBytes.length + body.length
+    const record = Buffer.alloc(size)
+    record[0] = type
+    record[1] = timeSize ? 1 : 0
+    record.writeUInt16LE(size, 2)
+    if (timeSize) record.writeDoubleLE(time, 4)
+    record[4 + timeSize] = nameBytes.length
+    nameBytes.copy(record, 5 + timeSize)
+    Buffer.from(body).copy(record, 5 + timeSize + nameBytes.length)
+    return new Uint8Array(record)
+}
+
+const cases = []
+function check(name, bytes, verify) {
+    cases.push({ name, bytes, verify })
+}
+
+// Every record type, with and without a sample time
+const full = new PdBatch(16) // trop petit exprès : force _reserve()
+full.bang('b')
+full.float('f', 1.5)
+full.symbol('s', 'hello')
+full.list('l', [1, 'two', -3.25, ''])
+full.bang('tb', 1024)
+full.float('tf', 0.1, 48000)
+full.symbol('ts', 'x', 2 ** 40)
+full.list('tl', [], 64)
+const fullBytes = full.finish()
+
+check('all record types', fullBytes, (r) => {
+    assert.strictEqual(r.end, fullBytes.length)
+    assert.deepStrictEqual(r.records, [
+        { type: 'bang', time: 0, receiver: 'b' },
+        { type: 'float', time: 0, receiver: 'f', value: 1.5 },
+        { type: 'symbol', time: 0, receiver: 's', symbol: 'hello' },
+        { type: 'list', time: 0, receiver: 'l', argc: 4, atoms: [1, 'two', -3.25, ''] },
+        { type: 'bang', time: 1024, receiver: 'tb' },
+        { type: 'float', time: 48000, receiver: 'tf', value: Math.fround(0.1) },
+        { type: 'symbol', time: 2 ** 40, receiver: 'ts', symbol: 'x' },
+        { type: 'list', time: 64, receiver: 'tl', argc: 0, atoms: [] },
+    ])
+})
+
+// Cut anywhere: the records before the cut decode, the cut one is rejected
+const boundaries = [0]
+{
+    const view = new DataView(fullBytes.buffer, fullBytes.byteOffset, fullBytes.length)
+    for (let pos = 0; pos < fullBytes.length; pos += view.getUint16(pos + 2, true)) {
+        boundaries.push(pos + view.getUint16(pos + 2, true))
+    }
+}
+for (let cut = 0; cut < fullBytes.length; ++cut) {
+    check(`truncated at ${cut}`, fullBytes.subarray(0, cut), (r) => {
+        const whole = boundaries.filter((b) => b <= cut)
+        const last = whole[whole.length - 1]
+        assert.strictEqual(r.records.length, whole.length - 1)
+        if (cut === last) assert.strictEqual(r.end, cut)
+        else assert.strictEqual(r.error, last)
+    })
+}
+
+// A size field larger or smaller than the record it announces
+{
+    const bytes = new PdBatch().float('f', 2).finish()
+    const longer = Uint8Array.from(bytes)
+    new DataView(longer.buffer).setUint16(2, bytes.length + 1, true)
+    check('size past the end', longer, (r) => assert.strictEqual(r.error, 0))
+    const shorter = Uint8Array.from(bytes)
+    new DataView(shorter.buffer).setUint16(2, bytes.length - 1, true)
+    check('size before the body ends', shorter, (r) => assert.strictEqual(r.error, 0))
+}
+
+// Lists: 240 bytes of atoms fit, 241 do not, on both sides
+{
+    const fits = new Array(48).fill(0.5) // 48 * 5 = 240 octets
+    const bytes = new PdBatch().list('l', fits).finish()
+    check('240-byte list', bytes, (r) => {
+        assert.strictEqual(r.end, bytes.length)
+        assert.strictEqual(r.records[0].argc, 48)
+        assert.deepStrictEqual(r.records[0].atoms, fits)
+    })
+    assert.throws(() => new PdBatch().list('l', fits.concat([''])), RangeError)
+
+    const atoms = Buffer.alloc(241)
+    for (let i = 0; i + 5 <= 240; i += 5) atoms[i] = 0x66
+    atoms[240] = 0x73
+    const oversize = rawRecord(3, 'l', Buffer.concat([Buffer.from([49]), atoms]))
+    check('241-byte list', oversize, (r) => assert.strictEqual(r.error, 0))
+}
+
+// Names: 63 bytes is the longest a PdCommand holds (NUL included in 64)
+{
+    const name63 = 'n'.repeat(63)
+    const bytes = new PdBatch().bang(name63).symbol('s', name63).finish()
+    check('63-byte names', bytes, (r) => {
+        assert.strictEqual(r.end, bytes.length)
+        assert.strictEqual(r.records[0].receiver, name63)
+        assert.strictEqual(r.records[1].symbol, name63)
+    })
+    const name64 = 'n'.repeat(64)
+    assert.throws(() => new PdBatch().bang(name64), RangeError)
+    assert.throws(() => new PdBatch().symbol('s', name64), RangeError)
+
+    check('64-byte receiver', rawRecord(0, name64, []), (r) => assert.strictEqual(r.error, 0))
+    const symbol64 = Buffer.concat([Buffer.from([64]), Buffer.from(name64)])
+    check('64-byte symbol', rawRecord(2, 's', symbol64), (r) => assert.strictEqual(r.error, 0))
+}
+
+// Sample times: the largest double below 2^64 decodes, non-finite or 2^64 and up do not
+{
+    const below = 2 ** 64 - 2 ** 11
+    check('time below 2^64', rawRecord(0, 'b', [], below), (r) => {
+        assert.strictEqual(r.end, 14)
+        assert.strictEqual(BigInt(r.records[0].time), BigInt(below))
+    })
+    check('time 2^64', rawRecord(0, 'b', [], 2 ** 64), (r) => assert.strictEqual(r.error, 0))
+    check('time 2^70', rawRecord(0, 'b', [], 2 ** 70), (r) => assert.strictEqual(r.error, 0))
+    check('time Infinity', rawRecord(0, 'b', [], Infinity), (r) => assert.strictEqual(r.error, 0))
+    check('time -Infinity', rawRecord(0, 'b', [], -Infinity), (r) => assert.strictEqual(r.error, 0))
+    check('time NaN', rawRecord(0, 'b', [], NaN), (r) => assert.strictEqual(r.error, 0))
+    check('negative time', rawRecord(0, 'b', [], -5), (r) => {
+        assert.strictEqual(r.end, 14)
+        assert.strictEqual(r.records[0].time, 0)
+    })
+    for (const time of [Infinity, -Infinity, NaN, -1, 'soon']) {
+        assert.throws(() => new PdBatch().bang('b', time), RangeError)
+    }
+    const bytes = new PdBatch().bang('b', 0).float('f', 1, 10n).finish()
+    check('zero and bigint times', bytes, (r) => {
+        assert.strictEqual(r.end, bytes.length)
+        assert.deepStrictEqual(r.records.map((rec) => rec.time), [0, 10])
+    })
+}
+
+// Unknown record type
+check('unknown type', rawRecord(4, 'x', []), (r) => assert.strictEqual(r.error, 0))
+
+const results = decode(cases.map((c) => c.bytes))
+let failed = 0
+cases.forEach((c, i) => {
+    try {
+        c.verify(results[i])
+    } catch (err) {
+        failed++
+        console.error(`FAIL ${c.name}: ${err.message}`)
+    }
+})
+console.log(`${cases.length - failed}/${cases.length} batch cases passed`)
+process.exit(failed ? 1 : 0)